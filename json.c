@@ -1,12 +1,92 @@
+#define _GNU_SOURCE	/* strtod_l() */
 #include <fcntl.h>
+#include <limits.h>
+#include <locale.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 #include "json.h"
+#include "json_int.h"
+#include "json_scan.h"
 
 static char *parse_value(char *begin, char *end, size_t *offset, size_t *len,
 	enum json_type *type);
 static char *parse_string(char *begin, char *end);
-static json_data *json_data_from_buf(buf_t *buf);
+static char *parse_misc(char *begin, char *end);
+static int parse_head(char *begin, char *end, size_t *offset,
+	enum json_type *type);
+
+/*
+ * Structural index ("tape") built by JSON_PARSE_INDEX. Every value of the
+ * document gets one entry in pre-order, so the children of a container are
+ * the entries between its own index and 'next', and siblings are found by
+ * following 'next' without looking at the buffer again.
+ *
+ * An entry is 16 bytes of 32-bit offsets, the types are kept apart in one
+ * byte each. The length of a name is found again from its quotes when its
+ * node is built. Inputs of 4GB or more are parsed without a tape.
+ */
+struct json_tape {
+	uint32_t next;		/* index of the entry after this subtree */
+	uint32_t name;		/* offset of the quoted name, 0 when none */
+	uint32_t value;		/* offset of the value */
+	uint32_t value_len;
+};
+
+#define TAPE_MAX_LEN	((size_t)UINT32_MAX)
+
+/* nodes added by the mutation API have no tape entry */
+#define TAPE_NONE	UINT32_MAX
+
+/*
+ * Bump allocator used by JSON_PARSE_ARENA. The document, its buffer and
+ * all of its nodes are carved out of a short list of blocks which are
+ * released together when the root is freed.
+ */
+#define ARENA_ALIGN	16
+#define ARENA_ROUND(n)	(((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_MIN_BLOCK	4096
+#define ARENA_MAX_BLOCK	(4 << 20)
+
+struct json_arena_block {
+	struct json_arena_block *next;
+};
+
+#define ARENA_HDR	ARENA_ROUND(sizeof(struct json_arena_block))
+
+struct json_arena {
+	struct json_arena_block *blocks;
+	char *ptr;
+	char *end;
+	size_t next_size;
+};
+
+/*
+ * Objects with at least 'hash_min' members get an open addressing index
+ * on their names the first time they are searched.
+ */
+#define HASH_MIN_DEFAULT	16
+
+static size_t hash_min = HASH_MIN_DEFAULT;
+
+/* threads of JSON_PARSE_PARALLEL, <= 0 for one per online CPU */
+static int parse_threads;
+
+/* per-document state, owned by the root json_data */
+struct json_doc {
+	char *buf;
+	size_t len;
+	unsigned int flags;
+	struct json_tape *tape;
+	unsigned char *tape_type;	/* enum json_type of every entry */
+	size_t ntape;
+	size_t tape_size;
+	struct json_arena arena;
+	int frozen;		/* read-only, see json_data_freeze() */
+	uint64_t id;		/* unique for the life of the process */
+};
+
+static uint64_t doc_ids;
 
 static int is_blank(char c)
 {
@@ -23,37 +103,220 @@ static int is_endofline(char c)
 }
 
 
-static json_data *json_data_alloc()
+static int json_arena_grow(struct json_arena *a, size_t size)
 {
-	json_data *d;
+	struct json_arena_block *b;
+	size_t bsize = a->next_size;
 
-	d = (json_data *)malloc(sizeof(*d));
-	if (!d) {
-		perror("malloc json error");
-		return NULL;
+	if (bsize < size)
+		bsize = size;
+
+	b = (struct json_arena_block *)malloc(ARENA_HDR + bsize);
+	if (!b) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc arena error");
+		return -1;
 	}
 
-	d->buf = NULL;
+	b->next = a->blocks;
+	a->blocks = b;
+	a->ptr = (char *)b + ARENA_HDR;
+	a->end = a->ptr + bsize;
+	if (a->next_size < ARENA_MAX_BLOCK)
+		a->next_size *= 2;
+
+	return 0;
+}
+
+static void *json_arena_alloc(struct json_arena *a, size_t size)
+{
+	void *p;
+
+	size = ARENA_ROUND(size);
+	if (((size_t)(a->end - a->ptr) < size) && json_arena_grow(a, size))
+		return NULL;
+
+	p = a->ptr;
+	a->ptr += size;
+
+	return p;
+}
+
+static void json_data_init(json_data *d, struct json_doc *doc)
+{
+	d->parsed = 0;
+	d->dirty = 0;
+	d->root = 0;
+	d->own = 0;
+	d->tape = TAPE_NONE;
+	d->nchild = 0;
 	d->name.p = NULL;
 	d->name.len = 0;
 	TAILQ_INIT(&d->head);
+	d->doc = doc;
+	d->parent = NULL;
+	d->vec = NULL;
+}
+
+static json_data *json_data_alloc(struct json_doc *doc)
+{
+	json_data *d;
+
+	if (doc && (doc->flags & JSON_PARSE_ARENA))
+		d = (json_data *)json_arena_alloc(&doc->arena, sizeof(*d));
+	else
+		d = (json_data *)malloc(sizeof(*d));
+	if (!d) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc json error");
+		return NULL;
+	}
+
+	JSON_STAT_INC(nodes);
+	json_data_init(d, doc);
 
 	return d;
 }
 
+static int json_data_is_arena(json_data *d)
+{
+	return d->doc && (d->doc->flags & JSON_PARSE_ARENA);
+}
+
+/* 'nchild' is 32-bit, json_data_get_count() returns an int anyway */
+static int json_data_full(json_data *d, const char *at)
+{
+	if (d->nchild < UINT32_MAX)
+		return 0;
+
+	json_error_set(JSON_ERR_LIMIT, "too many children", at);
+	return 1;
+}
+
+static void json_data_add(json_data *d, json_data *e)
+{
+	TAILQ_INSERT_TAIL(&d->head, e, next);
+	e->parent = d;
+	d->nchild++;
+}
+
+/*
+ * allocate a document with room for 'len' bytes of input in doc->buf,
+ * with JSON_PARSE_MMAP the caller maps the input into doc->buf instead
+ */
+static struct json_doc *json_doc_new(size_t len, unsigned int flags)
+{
+	struct json_arena a = { NULL, NULL, NULL, ARENA_MIN_BLOCK };
+	struct json_doc *doc;
+	size_t blen;
+
+	/* the on-demand nodes are found from the tape and kept in the arena */
+	if (flags & JSON_PARSE_COMPACT)
+		flags |= JSON_PARSE_INDEX | JSON_PARSE_ARENA;
+	blen = (flags & JSON_PARSE_MMAP) ? 0 : len;
+
+	if (flags & JSON_PARSE_ARENA) {
+		/* the first block holds the document, the input and some nodes */
+		if (json_arena_grow(&a, ARENA_ROUND(sizeof(*doc)) +
+			ARENA_ROUND(blen) + ARENA_MIN_BLOCK))
+			return NULL;
+		doc = (struct json_doc *)json_arena_alloc(&a, sizeof(*doc));
+		memset(doc, 0, sizeof(*doc));
+		if (blen)
+			doc->buf = (char *)json_arena_alloc(&a, blen);
+		doc->arena = a;
+	} else {
+		doc = (struct json_doc *)calloc(1, sizeof(*doc));
+		if (!doc) {
+			json_error_sys(JSON_ERR_NOMEM, "malloc doc error");
+			return NULL;
+		}
+		doc->arena = a;
+		if (blen)
+			doc->buf = (char *)malloc(blen);
+		if (blen && !doc->buf) {
+			json_error_sys(JSON_ERR_NOMEM, "malloc buf error");
+			free(doc);
+			return NULL;
+		}
+	}
+	doc->len = len;
+	doc->flags = flags;
+	doc->id = __atomic_add_fetch(&doc_ids, 1, __ATOMIC_RELAXED);
+
+	return doc;
+}
+
+static void json_doc_free(struct json_doc *doc)
+{
+	struct json_arena_block *b, *next;
+	int arena;
+
+	if (!doc)
+		return;
+
+	if (doc->tape)
+		free(doc->tape);
+	if (doc->tape_type)
+		free(doc->tape_type);
+
+	if ((doc->flags & JSON_PARSE_MMAP) && doc->buf) {
+		munmap(doc->buf, doc->len);
+		doc->buf = NULL;
+	}
+
+	/*
+	 * without JSON_PARSE_ARENA the arena only holds decoded strings,
+	 * otherwise 'doc' itself lives in the last block
+	 */
+	arena = doc->flags & JSON_PARSE_ARENA;
+	for (b = doc->arena.blocks; b; b = next) {
+		next = b->next;
+		free(b);
+	}
+	if (arena)
+		return;
+
+	if (doc->buf)
+		free(doc->buf);
+	free(doc);
+}
+
+/*
+ * the copy of a node added by mutation starts with its name, or with its
+ * value when it has none, see json_data_new_raw()
+ */
+static char *json_data_own_text(json_data *d)
+{
+	return d->name.p ? d->name.p : d->value.p;
+}
+
 void json_data_free(json_data *d)
 {
 	json_data *p, *tmp;
 
-	if (d) {
-		TAILQ_FOREACH_SAFE(p, &d->head, next, tmp) {
-			TAILQ_REMOVE(&d->head, p, next);
-			json_data_free(p);
-		}
-		if (d->buf)
-			free(d->buf);
-		free(d);
+	if (!d)
+		return;
+
+	/* arena nodes go away with their document, no need to walk them */
+	if (json_data_is_arena(d)) {
+		if (d->root)
+			json_doc_free(d->doc);
+		return;
+	}
+
+	TAILQ_FOREACH_SAFE(p, &d->head, next, tmp) {
+		TAILQ_REMOVE(&d->head, p, next);
+		json_data_free(p);
 	}
+	/* the 'str' of strings lives in the document arena */
+	if ((d->type == OBJECT) && d->hash)
+		free(d->hash);
+	if ((d->type == ARRAY) && d->vec)
+		free(d->vec);
+	if (d->own)
+		free(json_data_own_text(d));
+	if (d->root)
+		json_doc_free(d->doc);
+	free(d);
 }
 
 void print_buf(buf_t *buf)
@@ -74,12 +337,173 @@ void print_buf(buf_t *buf)
 	printf("\n");
 }
 
+/*
+ * JSON_PARSE_COMPACT: a container that is not materialized answers lookups
+ * from the tape. The tape entries of its children are listed on the first
+ * lookup, and a node is built for a child only when it is returned. Names
+ * get an index of child numbers, like 'hash', once the object is large.
+ */
+struct json_kids {
+	uint32_t n;
+	uint32_t mask;		/* of 'slots', 0 when there is none */
+	uint32_t *idx;		/* tape entry of every child */
+	uint32_t *slots;	/* child number + 1, by name */
+	json_data *node[];	/* NULL until returned by a lookup */
+};
+
+static int json_data_is_compact(json_data *d)
+{
+	return !d->parsed && (d->tape != TAPE_NONE) &&
+		(d->doc->flags & JSON_PARSE_COMPACT);
+}
+
+/*
+ * a container whose children failed to build keeps none, it is parsed
+ * again on the next access
+ */
+static void json_data_drop_children(json_data *d)
+{
+	json_data *e, *tmp;
+
+	TAILQ_FOREACH_SAFE(e, &d->head, next, tmp) {
+		TAILQ_REMOVE(&d->head, e, next);
+		json_data_free(e);
+	}
+	d->nchild = 0;
+}
+
+/* a node for tape entry 'i' */
+static void json_tape_node(struct json_doc *doc, json_data *e, uint32_t i)
+{
+	struct json_tape *t = &doc->tape[i];
+
+	e->type = (enum json_type)doc->tape_type[i];
+	if (t->name) {
+		/* the name was checked by the parse, its end is there */
+		e->name.p = doc->buf + t->name;
+		e->name.len = parse_string(e->name.p, doc->buf + doc->len) -
+			e->name.p + 1;
+	}
+	e->value.p = doc->buf + t->value;
+	e->value.len = t->value_len;
+	e->tape = i;
+}
+
+static uint32_t json_tape_count(struct json_doc *doc, uint32_t i)
+{
+	uint32_t end = doc->tape[i].next;
+	uint32_t n = 0;
+
+	for (i++; i < end; i = doc->tape[i].next)
+		n++;
+
+	return n;
+}
+
+/*
+ * materialize the children of 'd' from the tape, only names are rescanned.
+ * In an arena the nodes missing are carved in one run so that siblings are
+ * adjacent, the ones JSON_PARSE_COMPACT already returned are kept.
+ */
+static int json_tape_children(json_data *d)
+{
+	struct json_doc *doc = d->doc;
+	struct json_kids *k = d->kids;
+	json_data *run = NULL;
+	json_data *e;
+	uint32_t i, c, n;
+
+	n = k ? k->n : json_tape_count(doc, d->tape);
+	if (k) {
+		for (c = 0; c < k->n; c++)
+			if (k->node[c])
+				n--;
+	}
+	if (n && json_data_is_arena(d)) {
+		run = (json_data *)json_arena_alloc(&doc->arena,
+			n * sizeof(*run));
+		if (!run)
+			return -1;
+		JSON_STAT_ADD(nodes, n);
+	}
+
+	c = 0;
+	for (i = d->tape + 1; i < doc->tape[d->tape].next; i = doc->tape[i].next) {
+		if (k && k->node[c]) {
+			e = k->node[c];
+		} else if (run) {
+			e = run++;
+			json_data_init(e, doc);
+			json_tape_node(doc, e, i);
+		} else {
+			e = json_data_alloc(doc);
+			if (!e)
+				goto err;
+			json_tape_node(doc, e, i);
+		}
+		json_data_add(d, e);
+		c++;
+	}
+	d->kids = NULL;
+
+	return 0;
+
+err:
+	json_data_drop_children(d);
+	return -1;
+}
+
+static struct json_kids *json_kids_get(json_data *d)
+{
+	struct json_doc *doc = d->doc;
+	struct json_kids *k;
+	uint32_t i, n;
+
+	if (d->kids)
+		return d->kids;
+
+	n = json_tape_count(doc, d->tape);
+	k = (struct json_kids *)json_arena_alloc(&doc->arena, sizeof(*k) +
+		n * (sizeof(k->node[0]) + sizeof(*k->idx)));
+	if (!k)
+		return NULL;
+	k->n = n;
+	k->mask = 0;
+	k->slots = NULL;
+	k->idx = (uint32_t *)&k->node[n];
+	memset(k->node, 0, n * sizeof(k->node[0]));
+	n = 0;
+	for (i = d->tape + 1; i < doc->tape[d->tape].next; i = doc->tape[i].next)
+		k->idx[n++] = i;
+	d->kids = k;
+
+	return k;
+}
+
+static json_data *json_kids_node(json_data *d, struct json_kids *k,
+	uint32_t c)
+{
+	json_data *e = k->node[c];
+
+	if (e)
+		return e;
+
+	e = json_data_alloc(d->doc);
+	if (!e)
+		return NULL;
+	json_tape_node(d->doc, e, k->idx[c]);
+	e->parent = d;
+	k->node[c] = e;
+
+	return e;
+}
+
 static int json_parse_object(json_data *d)
 {
 	char *begin = d->value.p + 1;
 	char *end = d->value.p + d->value.len;
 	char *p = begin;
-	buf_t name;
+	buf_t name = { NULL, 0 };
 	size_t offset;
 	size_t len;
 	enum json_type type;
@@ -87,9 +511,13 @@ static int json_parse_object(json_data *d)
 	int completed = 0;
 	int ret = 0;
 
+	if (d->doc->tape && (d->tape != TAPE_NONE))
+		return json_tape_children(d);
+	JSON_STAT_ADD(bytes_scanned, d->value.len);
+
 	while (p < end) {
 		if (is_blank(*p) || is_endofline(*p)) {
-			p++;
+			p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
 			continue;
 		}
 		switch (*p) {
@@ -105,15 +533,18 @@ static int json_parse_object(json_data *d)
 			begin = p + 1;
 			p = parse_value(begin, end, &offset, &len, &type);
 			if (p && (len > 0)) {
-				e = json_data_alloc();
-				if (e) {
-					e->type = type;
-					e->name.p = name.p;
-					e->name.len = name.len;
-					e->value.p = begin + offset;
-					e->value.len = len;
-					TAILQ_INSERT_TAIL(&d->head, e, next);
+				e = json_data_full(d, begin) ? NULL :
+					json_data_alloc(d->doc);
+				if (!e) {
+					ret = -1;
+					break;
 				}
+				e->type = type;
+				e->name.p = name.p;
+				e->name.len = name.len;
+				e->value.p = begin + offset;
+				e->value.len = len;
+				json_data_add(d, e);
 			}
 			break;
 		case '}':
@@ -122,11 +553,14 @@ static int json_parse_object(json_data *d)
 		default:
 			break;
 		}
-		if (!p || completed)
+		if (!p || completed || ret)
 			break;
 		p++;
 	}
 
+	if (ret)
+		json_data_drop_children(d);
+
 	return ret;
 }
 
@@ -142,9 +576,13 @@ static int json_parse_array(json_data *d)
 	int completed = 0;
 	int ret = 0;
 
+	if (d->doc->tape && (d->tape != TAPE_NONE))
+		return json_tape_children(d);
+	JSON_STAT_ADD(bytes_scanned, d->value.len);
+
 	while (p < end) {
 		if (is_blank(*p) || is_endofline(*p)) {
-			p++;
+			p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
 			continue;
 		}
 		switch (*p) {
@@ -153,13 +591,16 @@ static int json_parse_array(json_data *d)
 			begin = p + 1;
 			p = parse_value(begin, end, &offset, &len, &type);
 			if (p && (len > 0)) {
-				e = json_data_alloc();
-				if (e) {
-					e->type = type;
-					e->value.p = begin + offset;
-					e->value.len = len;
-					TAILQ_INSERT_TAIL(&d->head, e, next);
+				e = json_data_full(d, begin) ? NULL :
+					json_data_alloc(d->doc);
+				if (!e) {
+					ret = -1;
+					break;
 				}
+				e->type = type;
+				e->value.p = begin + offset;
+				e->value.len = len;
+				json_data_add(d, e);
 			}
 			break;
 		case ']':
@@ -168,222 +609,1562 @@ static int json_parse_array(json_data *d)
 		default:
 			break;
 		}
-		if (!p || completed)
+		if (!p || completed || ret)
 			break;
 		p++;
 	}
 
+	if (ret)
+		json_data_drop_children(d);
+
 	return ret;
 }
 
-json_data *json_data_get_by_name(json_data *d, const char *name)
+/* element vector of an array, so that index lookups do not walk the list */
+static int json_vec_build(json_data *d)
 {
-	json_data *p = NULL;
-
-	if (!d || !name)
-		return NULL;
+	json_data **vec;
+	json_data *p;
+	size_t i = 0;
 
-	if (d->type != OBJECT) {
-		printf("json data is not object [type: %d]\n", d->type);
-		return NULL;
+	if (json_data_is_arena(d))
+		vec = (json_data **)json_arena_alloc(&d->doc->arena,
+			d->nchild * sizeof(*vec));
+	else
+		vec = (json_data **)malloc(d->nchild * sizeof(*vec));
+	if (!vec) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc vec error");
+		return -1;
 	}
 
-	if (TAILQ_EMPTY(&d->head)) {
-		if (json_parse_object(d))
-			return NULL;
+	TAILQ_FOREACH(p, &d->head, next)
+		vec[i++] = p;
+	d->vec = vec;
+
+	return 0;
+}
+
+/* build the children of a container once, with their vector or index */
+static int json_data_materialize(json_data *d)
+{
+	struct json_error_input in;
+	int ret;
+
+	if (d->parsed)
+		return 0;
+
+	JSON_STAT_INC(materializations);
+	json_error_enter(&in, d->doc->buf, d->doc->buf + d->doc->len);
+	if (d->type == OBJECT) {
+		ret = json_parse_object(d);
+	} else {
+		ret = json_parse_array(d);
+		if (!ret && d->nchild)
+			json_vec_build(d);
 	}
+	json_error_leave(&in);
+	if (!ret)
+		d->parsed = 1;
 
-	if (!TAILQ_EMPTY(&d->head)) {
-		TAILQ_FOREACH(p, &d->head, next) {
-			if (!strncmp(p->name.p+1, name, p->name.len-2))
-				break;
-		}
+	return ret;
+}
+
+/* FNV-1a over the name without its quotes */
+static size_t json_hash_name(const char *name, size_t len)
+{
+	size_t h = 2166136261u;
+
+	while (len--) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
 	}
 
-	return p;
+	return h;
 }
 
-json_data *json_data_get_by_index(json_data *d, int idx)
+static int json_name_equal(json_data *d, const char *name, size_t len)
 {
-	json_data *p = NULL;
-	int i = 0;
+	return (d->name.len == len + 2) && !memcmp(d->name.p + 1, name, len);
+}
 
-	if (!d || (index < 0))
-		return NULL;
+/* name index of an object, open addressing over 'mask' + 1 slots */
+struct json_hash {
+	size_t mask;
+	json_data *slots[];
+};
 
-	if (d->type != ARRAY) {
-		printf("json data is not array\n");
-		return NULL;
-	}
+static int json_hash_build(json_data *d)
+{
+	struct json_hash *h;
+	json_data **slots;
+	json_data *p;
+	size_t size = 16;
+	size_t i;
 
-	if (TAILQ_EMPTY(&d->head)) {
-		if (json_parse_array(d))
-			return NULL;
-	}
+	while (size < (size_t)d->nchild * 2)
+		size *= 2;
 
-	if (!TAILQ_EMPTY(&d->head)) {
-		TAILQ_FOREACH(p, &d->head, next) {
-			if (i++ == idx)
+	if (json_data_is_arena(d))
+		h = (struct json_hash *)json_arena_alloc(&d->doc->arena,
+			sizeof(*h) + size * sizeof(*slots));
+	else
+		h = (struct json_hash *)malloc(sizeof(*h) +
+			size * sizeof(*slots));
+	if (!h) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc hash error");
+		return -1;
+	}
+	h->mask = size - 1;
+	slots = h->slots;
+	memset(slots, 0, size * sizeof(*slots));
+
+	TAILQ_FOREACH(p, &d->head, next) {
+		i = json_hash_name(p->name.p + 1, p->name.len - 2) & (size - 1);
+		while (slots[i]) {
+			/* keep the first of duplicated names, as the list walk does */
+			if (json_name_equal(slots[i], p->name.p + 1, p->name.len - 2))
 				break;
+			i = (i + 1) & (size - 1);
 		}
+		if (!slots[i])
+			slots[i] = p;
 	}
 
-	return p;
+	d->hash = h;
+
+	return 0;
 }
 
-static int buf_to_bool(buf_t *buf, int *val)
+/* the name of tape entry 'i' is 'name', undecoded like json_name_equal() */
+static int json_tape_name_equal(struct json_doc *doc, uint32_t i,
+	const char *name, size_t len)
 {
-	char *p = buf->p;
-	size_t len = buf->len;
-	int ret = 0;
+	char *p = doc->buf + doc->tape[i].name;
+	char *end = doc->buf + doc->len;
 
-	switch (len) {
-	case 2:
-		if (!strncmp(p, "no", len))
-			*val = 0;
-		else
-			ret = -1;
-	case 3:
-		if (!strncmp(p, "yes", len))
-			*val = 1;
-		else
-			ret = -1;
-	case 4:
-		if (!strncmp(p, "null", len))
-			*val = 0;
-		else if (!strncmp(p, "true", len))
-			*val = 1;
-		else
-			ret = -1;
-	case 5:
-		if (!strncmp(p, "false", len))
-			*val = 0;
-		else
-			ret = -1;
-	default:
-		ret = -1;
-		break;
-	}
+	if (((size_t)(end - p) < len + 2) || (p[len + 1] != '"') ||
+		memcmp(p + 1, name, len))
+		return 0;
 
-	return ret;
+	/* the '"' after the text may be escaped */
+	return parse_string(p, end) == p + len + 1;
 }
 
-int json_data_to_ulong(json_data *d, unsigned long *val)
+static int json_kids_hash(json_data *d, struct json_kids *k)
 {
+	struct json_doc *doc = d->doc;
+	uint32_t *slots;
+	size_t size = 16;
+	size_t i, len;
+	uint32_t c;
 	char *p;
-	size_t len;
-	char *endptr = NULL;
-	char number[128];
-	int ival;
-	int ret = 0;
 
-	if (!d || !val)
-		return -1;
+	while (size < (size_t)k->n * 2)
+		size *= 2;
 
-	if (d->type != MISC) {
-		printf("json data cannot be convert to number\n");
+	slots = (uint32_t *)json_arena_alloc(&doc->arena, size * sizeof(*slots));
+	if (!slots)
 		return -1;
-	}
-
-	p = d->value.p;
-	len = d->value.len;
-	if ((*p >= '0') && (*p <= '9')) {
-		if (len < 128) {
-			memcpy(number, p, len);
-			number[len] = '\0';
-			*val = strtoul(number, &endptr, 0);
-			if (endptr != &number[len])
-				ret = -1;
-		} else {
-			ret = -1;
+	memset(slots, 0, size * sizeof(*slots));
+
+	for (c = 0; c < k->n; c++) {
+		p = doc->buf + doc->tape[k->idx[c]].name;
+		len = parse_string(p, doc->buf + doc->len) - p - 1;
+		i = json_hash_name(p + 1, len) & (size - 1);
+		while (slots[i]) {
+			/* keep the first of duplicated names */
+			if (json_tape_name_equal(doc, k->idx[slots[i] - 1], p + 1,
+				len))
+				break;
+			i = (i + 1) & (size - 1);
 		}
-	} else {
-		ret = buf_to_bool(&d->value, &ival);
-		*val = (unsigned long)ival;
+		if (!slots[i])
+			slots[i] = c + 1;
 	}
 
-	return ret;
+	k->slots = slots;
+	k->mask = size - 1;
+
+	return 0;
 }
 
-int json_data_to_long(json_data *d, long *val)
+/* get_by_name() of an object that is not materialized, see json_kids */
+static json_data *json_kids_by_name(json_data *d, const char *name)
 {
-	char *p;
-	size_t len;
-	char *endptr = NULL;
-	char number[128];
-	int ival;
-	int ret = 0;
+	struct json_kids *k;
+	size_t len = strlen(name);
+	size_t i;
+	uint32_t c;
 
-	if (!d || !val)
-		return -1;
+	k = json_kids_get(d);
+	if (!k)
+		return NULL;
 
-	if (d->type != MISC) {
-		printf("json data cannot be convert to number\n");
-		return -1;
+	if (!k->slots && hash_min && (k->n >= hash_min))
+		json_kids_hash(d, k);
+
+	JSON_STAT_INC(lookups);
+	if (k->slots) {
+		i = json_hash_name(name, len) & k->mask;
+		while ((c = k->slots[i]) != 0) {
+			JSON_STAT_INC(lookup_probes);
+			if (json_tape_name_equal(d->doc, k->idx[c - 1], name, len))
+				return json_kids_node(d, k, c - 1);
+			i = (i + 1) & k->mask;
+		}
+		return NULL;
 	}
 
-	p = d->value.p;
-	len = d->value.len;
-	if (((*p == '-') && (*(p+1) >= '0') && (*(p+1) <= '9')) ||
-		((*p >= '0') && (*p <= '9'))) {
-		if (len < 128) {
-			memcpy(number, p, len);
-			number[len] = '\0';
-			*val = strtol(number, &endptr, 0);
-			if (endptr != &number[len])
-				ret = -1;
-		} else {
-			ret = -1;
-		}
-	} else {
-		ret = buf_to_bool(&d->value, &ival);
-		*val = (long)ival;
+	for (c = 0; c < k->n; c++) {
+		JSON_STAT_INC(lookup_probes);
+		if (json_tape_name_equal(d->doc, k->idx[c], name, len))
+			return json_kids_node(d, k, c);
 	}
 
-	return ret;
+	return NULL;
 }
 
-int json_data_to_string(json_data *d, char *str, size_t size)
+void json_data_set_hash_min(size_t members)
 {
-	size_t len;
-
-	if (!d || !str)
-		return -1;
+	hash_min = members;
+}
 
-	if (d->type != STRING) {
-		printf("json data is not string\n");
-		return -1;
-	}
+void json_data_set_parse_threads(int nthreads)
+{
+	parse_threads = nthreads;
+}
+
+json_data *json_data_get_by_name(json_data *d, const char *name)
+{
+	json_data *p = NULL;
+	size_t len;
+	size_t i;
+
+	if (!d || !name)
+		return NULL;
+
+	if (d->type != OBJECT) {
+		json_error_set(JSON_ERR_TYPE, "json data is not object", NULL);
+		return NULL;
+	}
+
+	if (json_data_is_compact(d))
+		return json_kids_by_name(d, name);
+
+	if (json_data_materialize(d))
+		return NULL;
+
+	len = strlen(name);
+
+	/* a frozen document is never modified, see json_data_freeze() */
+	if (!d->hash && hash_min && (d->nchild >= hash_min) && !d->doc->frozen)
+		json_hash_build(d);
+
+	JSON_STAT_INC(lookups);
+	if (d->hash) {
+		i = json_hash_name(name, len) & d->hash->mask;
+		while ((p = d->hash->slots[i]) != NULL) {
+			JSON_STAT_INC(lookup_probes);
+			if (json_name_equal(p, name, len))
+				break;
+			i = (i + 1) & d->hash->mask;
+		}
+		return p;
+	}
+
+	TAILQ_FOREACH(p, &d->head, next) {
+		JSON_STAT_INC(lookup_probes);
+		if (json_name_equal(p, name, len))
+			break;
+	}
+
+	return p;
+}
+
+json_data *json_data_get_by_index(json_data *d, int idx)
+{
+	struct json_kids *k;
+	json_data *p = NULL;
+	int i = 0;
+
+	if (!d || (idx < 0))
+		return NULL;
+
+	if (d->type != ARRAY) {
+		json_error_set(JSON_ERR_TYPE, "json data is not array", NULL);
+		return NULL;
+	}
+
+	if (json_data_is_compact(d)) {
+		k = json_kids_get(d);
+		if (!k || ((uint32_t)idx >= k->n))
+			return NULL;
+		JSON_STAT_INC(lookups);
+		JSON_STAT_INC(lookup_probes);
+		return json_kids_node(d, k, idx);
+	}
+
+	if (json_data_materialize(d))
+		return NULL;
+
+	if ((size_t)idx >= d->nchild)
+		return NULL;
+
+	/* dropped by the mutation API, see json_data_changed() */
+	if (!d->vec && !d->doc->frozen)
+		json_vec_build(d);
+
+	JSON_STAT_INC(lookups);
+	if (d->vec) {
+		JSON_STAT_INC(lookup_probes);
+		return d->vec[idx];
+	}
+
+	TAILQ_FOREACH(p, &d->head, next) {
+		JSON_STAT_INC(lookup_probes);
+		if (i++ == idx)
+			break;
+	}
+
+	return p;
+}
+
+/* number of members of an object or elements of an array */
+int json_data_get_count(json_data *d)
+{
+	if (!d)
+		return -1;
+
+	if ((d->type != OBJECT) && (d->type != ARRAY)) {
+		json_error_set(JSON_ERR_TYPE, "json data is not object or array",
+			NULL);
+		return -1;
+	}
+
+	if (json_data_materialize(d))
+		return -1;
+
+	return (int)d->nchild;
+}
+
+const char *json_data_doc_text(json_data *d)
+{
+	return d->doc->buf;
+}
+
+/* identifies the document 'd' belongs to, ids are never reused */
+uint64_t json_data_doc_id(json_data *d)
+{
+	return (d && d->doc) ? d->doc->id : 0;
+}
+
+static int json_data_freeze_tree(json_data *d)
+{
+	json_data *p;
+	buf_t str;
+
+	/* the copy of an escaped string is made now, not by a reader */
+	if (d->type == STRING)
+		return json_data_get_string(d, &str);
+
+	if ((d->type != OBJECT) && (d->type != ARRAY))
+		return 0;
+
+	if (json_data_materialize(d))
+		return -1;
+
+	if ((d->type == OBJECT) && !d->hash && hash_min &&
+		(d->nchild >= hash_min) && json_hash_build(d))
+		return -1;
+
+	TAILQ_FOREACH(p, &d->head, next) {
+		if (json_data_freeze_tree(p))
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Materialize the whole document and decode its escaped strings so that
+ * lookups and json_data_get_string() never modify it again. Once this
+ * returns 0 the document can be read from any number of threads without
+ * locking; it must be called before the document is shared.
+ */
+int json_data_freeze(json_data *d)
+{
+	if (!d || !d->root) {
+		json_error_set(JSON_ERR_ARG, "only a root json data can be frozen",
+			NULL);
+		return -1;
+	}
+
+	if (d->doc->frozen)
+		return 0;
+
+	if (json_data_freeze_tree(d))
+		return -1;
+
+	d->doc->frozen = 1;
+
+	return 0;
+}
+
+static int buf_to_bool(buf_t *buf, int *val)
+{
+	char *p = buf->p;
+	size_t len = buf->len;
+	int ret = 0;
+
+	switch (len) {
+	case 2:
+		if (!strncmp(p, "no", len))
+			*val = 0;
+		else
+			ret = -1;
+		break;
+	case 3:
+		if (!strncmp(p, "yes", len))
+			*val = 1;
+		else
+			ret = -1;
+		break;
+	case 4:
+		if (!strncmp(p, "null", len))
+			*val = 0;
+		else if (!strncmp(p, "true", len))
+			*val = 1;
+		else
+			ret = -1;
+		break;
+	case 5:
+		if (!strncmp(p, "false", len))
+			*val = 0;
+		else
+			ret = -1;
+		break;
+	default:
+		ret = -1;
+		break;
+	}
+
+	return ret;
+}
+
+static int is_digit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+static int hex_digit(char c)
+{
+	if (is_digit(c))
+		return c - '0';
+	if ((c >= 'a') && (c <= 'f'))
+		return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F'))
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * unsigned integer in [p, p + len), with the prefixes strtoul() accepts
+ * in base 0: "0x" for hex and a leading '0' for octal
+ */
+static int buf_to_u64(const char *p, size_t len, uint64_t *val)
+{
+	const char *begin = p;
+	const char *end = p + len;
+	unsigned int base = 10;
+	uint64_t v = 0;
+	int c;
+
+	if (len == 0)
+		goto err;
+
+	if ((len > 2) && (p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X'))) {
+		base = 16;
+		p += 2;
+	} else if ((len > 1) && (p[0] == '0')) {
+		base = 8;
+		p++;
+	}
+
+	while (p < end) {
+		c = hex_digit(*p++);
+		if ((c < 0) || ((unsigned int)c >= base))
+			goto err;
+		if (__builtin_mul_overflow(v, base, &v) ||
+			__builtin_add_overflow(v, (uint64_t)c, &v)) {
+			json_error_set(JSON_ERR_RANGE, "number does not fit", begin);
+			return -1;
+		}
+	}
+	*val = v;
+
+	return 0;
+
+err:
+	json_error_set(JSON_ERR_SYNTAX, "value is not a number", begin);
+	return -1;
+}
+
+static int buf_to_i64(const char *p, size_t len, int64_t *val)
+{
+	uint64_t v;
+
+	if ((len > 0) && (*p == '-')) {
+		if (buf_to_u64(p + 1, len - 1, &v))
+			return -1;
+		if (v > (uint64_t)INT64_MAX + 1)
+			goto range;
+		*val = (int64_t)(0 - v);
+	} else {
+		if (buf_to_u64(p, len, &v))
+			return -1;
+		if (v > INT64_MAX)
+			goto range;
+		*val = (int64_t)v;
+	}
+
+	return 0;
+
+range:
+	json_error_set(JSON_ERR_RANGE, "number does not fit", p);
+	return -1;
+}
+
+static const double pow10_exact[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MANTISSA_MAX	((uint64_t)1 << 53)
+
+locale_t json_c_locale(void)
+{
+	static locale_t c_locale;
+	locale_t l = __atomic_load_n(&c_locale, __ATOMIC_ACQUIRE);
+	locale_t n;
+
+	if (l)
+		return l;
+
+	n = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+	if (!n) {
+		json_error_sys(JSON_ERR_NOMEM, "newlocale error");
+		return NULL;
+	}
+	/* another thread may have made one first, it is the one kept */
+	if (!__atomic_compare_exchange_n(&c_locale, &l, n, 0, __ATOMIC_ACQ_REL,
+		__ATOMIC_ACQUIRE)) {
+		freelocale(n);
+		return l;
+	}
+
+	return n;
+}
+
+/*
+ * Numbers with at most 19 significant digits whose mantissa and power of
+ * ten are both exact doubles take one multiplication or division, which is
+ * correctly rounded. Anything else goes to strtod().
+ */
+static int buf_to_double(const char *p, size_t len, double *val)
+{
+	const char *begin = p;
+	const char *end = p + len;
+	uint64_t m = 0;
+	int digits = 0;
+	int neg = 0;
+	int e10 = 0;
+	int e = 0;
+	int eneg = 0;
+	char number[128];
+	char *endptr = NULL;
+	char *s;
+	locale_t loc;
+	double d;
+	int ret;
+
+	if ((p < end) && (*p == '-')) {
+		neg = 1;
+		p++;
+	}
+	if ((p == end) || !is_digit(*p))
+		goto err;
+
+	while ((p < end) && is_digit(*p)) {
+		if (digits < 19) {
+			m = m * 10 + (*p - '0');
+			if (m)
+				digits++;
+		} else {
+			e10++;
+			digits++;
+		}
+		p++;
+	}
+	if ((p < end) && (*p == '.')) {
+		p++;
+		if ((p == end) || !is_digit(*p))
+			goto err;
+		while ((p < end) && is_digit(*p)) {
+			if (digits < 19) {
+				m = m * 10 + (*p - '0');
+				e10--;
+				if (m)
+					digits++;
+			} else {
+				digits++;
+			}
+			p++;
+		}
+	}
+	if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+		p++;
+		if ((p < end) && ((*p == '-') || (*p == '+')))
+			eneg = (*p++ == '-');
+		if ((p == end) || !is_digit(*p))
+			goto err;
+		while ((p < end) && is_digit(*p)) {
+			if (e < 100000)
+				e = e * 10 + (*p - '0');
+			p++;
+		}
+		e10 += eneg ? -e : e;
+	}
+	if (p != end)
+		goto err;
+
+	if (m == 0) {
+		*val = neg ? -0.0 : 0.0;
+		return 0;
+	}
+
+	if ((digits <= 19) && (m <= MANTISSA_MAX)) {
+		if ((e10 >= -22) && (e10 <= 22)) {
+			d = (double)m;
+			d = (e10 < 0) ? d / pow10_exact[-e10] : d * pow10_exact[e10];
+			*val = neg ? -d : d;
+			return 0;
+		}
+		/* 123e30: move some of the power into the mantissa if it stays exact */
+		if ((e10 > 22) && (e10 <= 22 + 15)) {
+			d = (double)m * pow10_exact[e10 - 22];
+			if (d <= (double)MANTISSA_MAX) {
+				d *= 1e22;
+				*val = neg ? -d : d;
+				return 0;
+			}
+		}
+	}
+
+	/* the "C" locale, a ',' decimal point of LC_NUMERIC would stop it */
+	loc = json_c_locale();
+	if (!loc)
+		return -1;
+	s = (len < sizeof(number)) ? number : (char *)malloc(len + 1);
+	if (!s) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc number error");
+		return -1;
+	}
+	memcpy(s, begin, len);
+	s[len] = '\0';
+	*val = strtod_l(s, &endptr, loc);
+	ret = (endptr == &s[len]) ? 0 : -1;
+	if (s != number)
+		free(s);
+	if (ret)
+		goto err;
+
+	return 0;
+
+err:
+	json_error_set(JSON_ERR_SYNTAX, "value is not a number", begin);
+	return -1;
+}
+
+/* the text of a MISC value, numbers and the words of buf_to_bool() */
+static int value_to_u64(buf_t *v, uint64_t *val)
+{
+	int64_t i;
+	int ival;
+
+	if (is_digit(*v->p))
+		return buf_to_u64(v->p, v->len, val);
+	/* a negative integer is a number, one that does not fit */
+	if ((*v->p == '-') && (v->len > 1) && is_digit(*(v->p + 1))) {
+		if (buf_to_i64(v->p, v->len, &i))
+			return -1;
+		if (i < 0) {
+			json_error_set(JSON_ERR_RANGE, "number does not fit", v->p);
+			return -1;
+		}
+		*val = 0;
+		return 0;
+	}
+	if (buf_to_bool(v, &ival)) {
+		json_error_set(JSON_ERR_SYNTAX, "value is not a number", v->p);
+		return -1;
+	}
+	*val = (uint64_t)ival;
+
+	return 0;
+}
+
+static int value_to_i64(buf_t *v, int64_t *val)
+{
+	char *p = v->p;
+	int ival;
+
+	if (is_digit(*p) || ((*p == '-') && (v->len > 1) && is_digit(*(p+1))))
+		return buf_to_i64(p, v->len, val);
+	if (buf_to_bool(v, &ival)) {
+		json_error_set(JSON_ERR_SYNTAX, "value is not a number", v->p);
+		return -1;
+	}
+	*val = (int64_t)ival;
+
+	return 0;
+}
+
+static int value_to_double(buf_t *v, double *val)
+{
+	int ival;
+
+	if (is_digit(*v->p) || (*v->p == '-'))
+		return buf_to_double(v->p, v->len, val);
+	if (buf_to_bool(v, &ival)) {
+		json_error_set(JSON_ERR_SYNTAX, "value is not a number", v->p);
+		return -1;
+	}
+	*val = (double)ival;
+
+	return 0;
+}
+
+int json_data_to_uint64(json_data *d, uint64_t *val)
+{
+	int ret;
+
+	if (!d || !val)
+		return -1;
+
+	if (d->type != MISC) {
+		JSON_STAT_INC(conversion_failures);
+		json_error_set(JSON_ERR_TYPE, "json data cannot be convert to number",
+			NULL);
+		return -1;
+	}
+
+	ret = value_to_u64(&d->value, val);
+	if (ret)
+		JSON_STAT_INC(conversion_failures);
+
+	return ret;
+}
+
+int json_data_to_int64(json_data *d, int64_t *val)
+{
+	int ret;
+
+	if (!d || !val)
+		return -1;
+
+	if (d->type != MISC) {
+		JSON_STAT_INC(conversion_failures);
+		json_error_set(JSON_ERR_TYPE, "json data cannot be convert to number",
+			NULL);
+		return -1;
+	}
+
+	ret = value_to_i64(&d->value, val);
+	if (ret)
+		JSON_STAT_INC(conversion_failures);
+
+	return ret;
+}
+
+int json_data_to_double(json_data *d, double *val)
+{
+	int ret;
+
+	if (!d || !val)
+		return -1;
+
+	if (d->type != MISC) {
+		JSON_STAT_INC(conversion_failures);
+		json_error_set(JSON_ERR_TYPE, "json data cannot be convert to number",
+			NULL);
+		return -1;
+	}
+
+	ret = value_to_double(&d->value, val);
+	if (ret)
+		JSON_STAT_INC(conversion_failures);
+
+	return ret;
+}
+
+int json_data_to_ulong(json_data *d, unsigned long *val)
+{
+	uint64_t v;
+
+	if (!val || json_data_to_uint64(d, &v))
+		return -1;
+	if (v > ULONG_MAX) {
+		JSON_STAT_INC(conversion_failures);
+		json_error_set(JSON_ERR_RANGE, "number does not fit", NULL);
+		return -1;
+	}
+	*val = (unsigned long)v;
+
+	return 0;
+}
+
+int json_data_to_long(json_data *d, long *val)
+{
+	int64_t v;
+
+	if (!val || json_data_to_int64(d, &v))
+		return -1;
+	if ((v < LONG_MIN) || (v > LONG_MAX)) {
+		JSON_STAT_INC(conversion_failures);
+		json_error_set(JSON_ERR_RANGE, "number does not fit", NULL);
+		return -1;
+	}
+	*val = (long)v;
+
+	return 0;
+}
+
+/*
+ * Decimal digits read 8 at a time: the bytes less '0' are checked
+ * together, the run of leading digits is moved to the top of the word,
+ * then pairs, quads and octets of digits are combined with three
+ * multiplications. A borrow or carry out of a byte only spoils the bytes
+ * after it, which are past the run. Only little endian hosts take this
+ * path, 8 bytes at 'p' must be readable.
+ */
+static int swar_digits(const char *p, uint64_t *val)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t v, bad;
+	int n;
+
+	memcpy(&v, p, sizeof(v));
+	v -= 0x3030303030303030ULL;
+	bad = (v | (v + 0x0606060606060606ULL)) & 0xf0f0f0f0f0f0f0f0ULL;
+	n = bad ? __builtin_ctzll(bad) / 8 : 8;
+	if (n == 0)
+		return 0;
+
+	v <<= 8 * (8 - n);
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32))) +
+		(((v >> 16) & 0x000000ff000000ffULL) *
+		(1 + (10000ULL << 32)))) >> 32;
+	*val = v;
+
+	return n;
+#else
+	return 0;
+#endif
+}
+
+static const uint64_t pow10_u64[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+/*
+ * A plain decimal number of up to 15 digits at 'p', without the leading
+ * '0' that buf_to_u64() reads as octal, followed by a delimiter. Returns
+ * its end, or NULL for the slow path. 'lim' bounds the 16 bytes read.
+ */
+static char *swar_number(char *p, char *end, char *lim, uint64_t *val)
+{
+	uint64_t hi, lo;
+	int n, m;
+
+	if (lim - p < 16)
+		return NULL;
+
+	n = swar_digits(p, &hi);
+	if ((n == 0) || ((p[0] == '0') && (n > 1)))
+		return NULL;
+	if (n == 8) {
+		m = swar_digits(p + 8, &lo);
+		if (m == 8)
+			return NULL;
+		hi = hi * pow10_u64[m] + (m ? lo : 0);
+		n += m;
+	}
+	p += n;
+
+	if ((p < end) && (*p != ',') &&
+		!(json_scan_class[(unsigned char)*p] & JSON_SCAN_BLANK))
+		return NULL;
+	*val = hi;
+
+	return p;
+}
+
+enum bulk_type {
+	BULK_INT64 = 0,
+	BULK_UINT64,
+	BULK_DOUBLE,
+};
+
+/* the slow path, every syntax json_data_to_*() accepts */
+static int bulk_value(enum bulk_type t, buf_t *v, void *vals, size_t i)
+{
+	switch (t) {
+	case BULK_UINT64:
+		return value_to_u64(v, &((uint64_t *)vals)[i]);
+	case BULK_INT64:
+		return value_to_i64(v, &((int64_t *)vals)[i]);
+	default:
+		return value_to_double(v, &((double *)vals)[i]);
+	}
+}
+
+/* the fast path of integers, returns the end of the number or NULL */
+static char *bulk_int(enum bulk_type t, char *p, char *end, char *lim,
+	void *vals, size_t i)
+{
+	uint64_t u;
+	char *q;
+
+	if (t == BULK_UINT64) {
+		q = swar_number(p, end, lim, &u);
+		if (q)
+			((uint64_t *)vals)[i] = u;
+		return q;
+	}
+
+	if (*p != '-') {
+		q = swar_number(p, end, lim, &u);
+		if (q)
+			((int64_t *)vals)[i] = (int64_t)u;
+	} else {
+		q = swar_number(p + 1, end, lim, &u);
+		if (q)
+			((int64_t *)vals)[i] = -(int64_t)u;
+	}
+
+	return q;
+}
+
+static int bulk_error(json_data *d, enum json_error_code code,
+	const char *msg, const char *at)
+{
+	struct json_error_input in;
+
+	JSON_STAT_INC(conversion_failures);
+	json_error_enter(&in, d->doc->buf, d->doc->buf + d->doc->len);
+	json_error_set(code, msg, at);
+	json_error_leave(&in);
+
+	return -1;
+}
+
+/* elements of a modified array, the text is no longer the content */
+static int bulk_nodes(json_data *d, enum bulk_type t, void *vals,
+	size_t max, size_t *n)
+{
+	json_data *e;
+	size_t i = 0;
+
+	if (json_data_materialize(d))
+		return -1;
+
+	TAILQ_FOREACH(e, &d->head, next) {
+		*n = i;
+		if (i == max)
+			return bulk_error(d, JSON_ERR_LIMIT,
+				"array has more elements than the buffer", NULL);
+		if (e->type != MISC)
+			return bulk_error(d, JSON_ERR_TYPE,
+				"element is not a number", NULL);
+		if (bulk_value(t, &e->value, vals, i))
+			return bulk_error(d, JSON_ERR_RANGE,
+				"element cannot be convert to number", NULL);
+		i++;
+	}
+	*n = i;
+
+	return 0;
+}
+
+/* one pass over the text of the array, no node is built */
+static int bulk_decode(json_data *d, enum bulk_type t, void *vals,
+	size_t max, size_t *n)
+{
+	char *p, *end, *lim, *q;
+	buf_t v;
+	size_t i = 0;
+
+	if (!d || !vals || !n)
+		return -1;
+	*n = 0;
+
+	if (d->type != ARRAY) {
+		json_error_set(JSON_ERR_TYPE, "json data is not array", NULL);
+		return -1;
+	}
+	if (d->dirty)
+		return bulk_nodes(d, t, vals, max, n);
+
+	/* the text is a complete array, it ends with ']' */
+	p = d->value.p + 1;
+	end = d->value.p + d->value.len - 1;
+	/*
+	 * the fast path may read past the array up to the end of its buffer,
+	 * text added by mutation lives in its own copy, not in the document
+	 */
+	lim = d->doc->buf + d->doc->len;
+	if ((d->value.p < d->doc->buf) || (d->value.p >= lim))
+		lim = d->value.p + d->value.len;
+	p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+	while (p < end) {
+		*n = i;
+		if (i == max)
+			return bulk_error(d, JSON_ERR_LIMIT,
+				"array has more elements than the buffer", p);
+		if ((*p == '\"') || (*p == '{') || (*p == '['))
+			return bulk_error(d, JSON_ERR_TYPE,
+				"element is not a number", p);
+
+		q = (t != BULK_DOUBLE) ? bulk_int(t, p, end, lim, vals, i) : NULL;
+		if (!q) {
+			q = (char *)json_scan_find(p, end,
+				JSON_SCAN_COMMA | JSON_SCAN_BLANK);
+			v.p = p;
+			v.len = q - p;
+			if (!v.len || bulk_value(t, &v, vals, i))
+				return bulk_error(d, JSON_ERR_RANGE,
+					"element cannot be convert to number", p);
+		}
+		i++;
+
+		p = (char *)json_scan_skip(q, end, JSON_SCAN_BLANK);
+		if (p == end)
+			break;
+		if (*p != ',') {
+			*n = i;
+			return bulk_error(d, JSON_ERR_SYNTAX, "',' is missing", p);
+		}
+		p = (char *)json_scan_skip(p + 1, end, JSON_SCAN_BLANK);
+	}
+	*n = i;
+
+	return 0;
+}
+
+int json_data_to_int64_array(json_data *d, int64_t *vals, size_t max,
+	size_t *n)
+{
+	return bulk_decode(d, BULK_INT64, vals, max, n);
+}
+
+int json_data_to_uint64_array(json_data *d, uint64_t *vals, size_t max,
+	size_t *n)
+{
+	return bulk_decode(d, BULK_UINT64, vals, max, n);
+}
+
+int json_data_to_double_array(json_data *d, double *vals, size_t max,
+	size_t *n)
+{
+	return bulk_decode(d, BULK_DOUBLE, vals, max, n);
+}
+
+static int hex_to_u16(const char *p, unsigned int *val)
+{
+	unsigned int v = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		v <<= 4;
+		if ((p[i] >= '0') && (p[i] <= '9'))
+			v |= p[i] - '0';
+		else if ((p[i] >= 'a') && (p[i] <= 'f'))
+			v |= p[i] - 'a' + 10;
+		else if ((p[i] >= 'A') && (p[i] <= 'F'))
+			v |= p[i] - 'A' + 10;
+		else
+			return -1;
+	}
+	*val = v;
+
+	return 0;
+}
+
+static size_t utf8_put(char *out, unsigned int cp)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = 0xc0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = 0xe0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+	out[0] = 0xf0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3f);
+	out[2] = 0x80 | ((cp >> 6) & 0x3f);
+	out[3] = 0x80 | (cp & 0x3f);
+	return 4;
+}
+
+/*
+ * decode the escapes of the string body [p, end) into 'out', which has
+ * room for 'size' bytes. The output is never longer than the input. The
+ * runs between backslashes are found with the vector scanner and copied
+ * whole. Returns the length of the output or -1.
+ */
+static ssize_t string_unescape(const char *p, const char *end, char *out,
+	size_t size)
+{
+	const char *q;
+	size_t n = 0;
+	unsigned int cp, lo;
+	char c;
+
+	while (p < end) {
+		q = json_scan_find(p, end, JSON_SCAN_BACKSLASH);
+		if ((size_t)(q - p) > size - n)
+			goto nospace;
+		memcpy(out + n, p, q - p);
+		n += q - p;
+		if (q == end)
+			break;
+
+		if (end - q < 2)
+			goto bad;
+		switch (q[1]) {
+		case '\"': c = '\"'; break;
+		case '\\': c = '\\'; break;
+		case '/': c = '/'; break;
+		case 'b': c = '\b'; break;
+		case 'f': c = '\f'; break;
+		case 'n': c = '\n'; break;
+		case 'r': c = '\r'; break;
+		case 't': c = '\t'; break;
+		case 'u':
+			if ((end - q < 6) || hex_to_u16(q + 2, &cp))
+				goto bad;
+			p = q + 6;
+			if ((cp >= 0xdc00) && (cp <= 0xdfff))
+				goto bad;	/* lone low surrogate */
+			if ((cp >= 0xd800) && (cp <= 0xdbff)) {
+				if ((end - p < 6) || (p[0] != '\\') || (p[1] != 'u') ||
+					hex_to_u16(p + 2, &lo) ||
+					(lo < 0xdc00) || (lo > 0xdfff))
+					goto bad;
+				cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+				p += 6;
+			}
+			if (size - n < 4)
+				goto nospace;
+			n += utf8_put(out + n, cp);
+			continue;
+		default:
+			goto bad;
+		}
+		if (n == size)
+			goto nospace;
+		out[n++] = c;
+		p = q + 2;
+	}
+
+	return n;
+
+nospace:
+	json_error_set(JSON_ERR_SPACE,
+		"space is not enough to contain string", NULL);
+	return -1;
+
+bad:
+	json_error_set(JSON_ERR_ESCAPE, "bad escape sequence in string", q);
+	return -1;
+}
+
+static int json_data_string_body(json_data *d, const char **p,
+	const char **end)
+{
+	if (d->type != STRING) {
+		json_error_set(JSON_ERR_TYPE, "json data is not string", NULL);
+		return -1;
+	}
 
 	if (d->value.len < 2) {
-		printf("incomplete string\n");
+		json_error_set(JSON_ERR_SYNTAX, "incomplete string", NULL);
+		return -1;
+	}
+
+	*p = d->value.p + 1;
+	*end = d->value.p + d->value.len - 1;
+
+	return 0;
+}
+
+int json_data_to_string(json_data *d, char *str, size_t size)
+{
+	const char *p, *end;
+	size_t len;
+	ssize_t n;
+
+	if (!d || !str)
+		return -1;
+
+	if (json_data_string_body(d, &p, &end))
+		goto fail;
+
+	len = end - p;
+	if (json_scan_find(p, end, JSON_SCAN_BACKSLASH) == end) {
+		if (size <= len) {
+			json_error_set(JSON_ERR_SPACE,
+				"space is not enough to contain string", NULL);
+			goto fail;
+		}
+		if (len > 0)
+			memcpy(str, p, len);
+		str[len] = '\0';
+		return 0;
+	}
+
+	if (size == 0) {
+		json_error_set(JSON_ERR_SPACE,
+			"space is not enough to contain string", NULL);
+		goto fail;
+	}
+	n = string_unescape(p, end, str, size - 1);
+	if (n < 0)
+		goto fail;
+	str[n] = '\0';
+
+	return 0;
+
+fail:
+	JSON_STAT_INC(conversion_failures);
+	return -1;
+}
+
+int json_data_get_string(json_data *d, buf_t *str)
+{
+	const char *p, *end;
+	char *out;
+	ssize_t n;
+
+	if (!d || !str)
+		return -1;
+
+	if (json_data_string_body(d, &p, &end))
+		return -1;
+
+	/* no escape: a view of the document text */
+	if (json_scan_find(p, end, JSON_SCAN_BACKSLASH) == end) {
+		str->p = (char *)p;
+		str->len = end - p;
+		return 0;
+	}
+
+	/* the length is kept in front of the copy, it may hold a '\0' */
+	if (d->str) {
+		memcpy(&str->len, d->str, sizeof(str->len));
+		str->p = d->str + sizeof(str->len);
+		return 0;
+	}
+
+	if (!d->doc) {
+		json_error_set(JSON_ERR_ARG, "string has no document to keep "
+			"its copy, use json_data_to_string()", NULL);
+		return -1;
+	}
+	out = (char *)json_arena_alloc(&d->doc->arena,
+		sizeof(str->len) + (end - p) + 1);
+	if (!out) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc string error");
+		return -1;
+	}
+	n = string_unescape(p, end, out + sizeof(str->len), end - p);
+	if (n < 0)
+		return -1;
+	str->p = out + sizeof(str->len);
+	str->len = n;
+	str->p[n] = '\0';
+	memcpy(out, &str->len, sizeof(str->len));
+	d->str = out;
+
+	return 0;
+}
+
+/* drop the lookup structures of 'd' and mark it and its parents dirty */
+static void json_data_changed(json_data *d)
+{
+	json_data *p;
+
+	/* 'hash' of objects and 'vec' of arrays share their pointer */
+	if (!json_data_is_arena(d) && d->vec)
+		free(d->vec);
+	d->vec = NULL;
+
+	for (p = d; p; p = p->parent)
+		p->dirty = 1;
+
+	/* resolutions cached against the old content are no longer valid */
+	d->doc->id = __atomic_add_fetch(&doc_ids, 1, __ATOMIC_RELAXED);
+}
+
+static int json_data_mutable(json_data *d, enum json_type type)
+{
+	if (d->type != type) {
+		json_error_set(JSON_ERR_TYPE, (type == OBJECT) ?
+			"json data is not object" : "json data is not array", NULL);
+		return -1;
+	}
+
+	if (d->doc->frozen) {
+		json_error_set(JSON_ERR_FROZEN, "json data is frozen", NULL);
+		return -1;
+	}
+
+	return json_data_materialize(d);
+}
+
+/*
+ * names are given as they appear between the quotes, like lookups take
+ * them, so they must already be escaped
+ */
+static int json_name_valid(const char *name)
+{
+	const unsigned char *p = (const unsigned char *)name;
+
+	for (; *p; p++) {
+		if ((*p < 0x20) || (*p == '\"'))
+			return 0;
+		if (*p == '\\') {
+			p++;
+			if (!*p || !strchr("\"\\/bfnrtu", *p))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* a node owning a copy of 'text', one complete value, named if 'name' */
+static json_data *json_data_new_raw(json_data *parent, const char *name,
+	const char *text, size_t len)
+{
+	size_t nlen = name ? strlen(name) + 2 : 0;
+	size_t offset;
+	size_t vlen = 0;
+	enum json_type type;
+	const char *p;
+	char *own, *end;
+	json_data *e;
+
+	/* the value starts the copy when there is no name */
+	if (text) {
+		p = json_scan_skip(text, text + len, JSON_SCAN_BLANK);
+		len -= p - text;
+		text = p;
+	}
+	if (!text || (len == 0)) {
+		json_error_set(JSON_ERR_ARG, "value is empty", NULL);
+		return NULL;
+	}
+	if (json_data_full(parent, NULL))
+		return NULL;
+
+	if (json_data_is_arena(parent))
+		own = (char *)json_arena_alloc(&parent->doc->arena, nlen + len);
+	else
+		own = (char *)malloc(nlen + len);
+	if (!own) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc value error");
+		return NULL;
+	}
+
+	if (name) {
+		own[0] = '\"';
+		memcpy(own + 1, name, nlen - 2);
+		own[nlen - 1] = '\"';
+	}
+	memcpy(own + nlen, text, len);
+
+	end = parse_value(own + nlen, own + nlen + len, &offset, &vlen, &type);
+	if (!end || (vlen == 0) || ((char *)json_scan_skip(end + 1,
+		own + nlen + len, JSON_SCAN_BLANK) < own + nlen + len)) {
+		json_error_set(JSON_ERR_SYNTAX, "text is not a single value", NULL);
+		goto err;
+	}
+
+	e = json_data_alloc(parent->doc);
+	if (!e)
+		goto err;
+	e->type = type;
+	if (name) {
+		e->name.p = own;
+		e->name.len = nlen;
+	}
+	e->value.p = own + nlen + offset;
+	e->value.len = vlen;
+	e->dirty = 1;
+	if (!json_data_is_arena(parent))
+		e->own = 1;
+
+	return e;
+
+err:
+	if (!json_data_is_arena(parent))
+		free(own);
+	return NULL;
+}
+
+/* swap 'e' in for 'old', or append it when 'old' is NULL */
+static void json_data_put(json_data *d, json_data *old, json_data *e)
+{
+	if (old) {
+		TAILQ_INSERT_BEFORE(old, e, next);
+		TAILQ_REMOVE(&d->head, old, next);
+		e->parent = d;
+		if (!json_data_is_arena(old))
+			json_data_free(old);
+	} else {
+		json_data_add(d, e);
+	}
+	json_data_changed(d);
+}
+
+/* set member 'name' of an object to the encoded value 'text' */
+int json_data_set_raw(json_data *d, const char *name, const char *text,
+	size_t len)
+{
+	json_data *old = NULL;
+	json_data *e;
+
+	if (!d || !name || json_data_mutable(d, OBJECT))
+		return -1;
+	if (!json_name_valid(name)) {
+		json_error_set(JSON_ERR_ARG, "name is not escaped", NULL);
+		return -1;
+	}
+
+	if (d->nchild)
+		old = json_data_get_by_name(d, name);
+
+	e = json_data_new_raw(d, name, text, len);
+	if (!e)
+		return -1;
+	json_data_put(d, old, e);
+
+	return 0;
+}
+
+/* insert before element 'idx' of an array, -1 or the count appends */
+int json_data_insert_raw(json_data *d, int idx, const char *text, size_t len)
+{
+	json_data *at = NULL;
+	json_data *e;
+
+	if (!d || json_data_mutable(d, ARRAY))
+		return -1;
+
+	if ((idx >= 0) && ((size_t)idx < d->nchild))
+		at = json_data_get_by_index(d, idx);
+	else if ((idx != -1) && ((size_t)idx != d->nchild)) {
+		json_error_set(JSON_ERR_ARG, "index is out of range", NULL);
+		return -1;
+	}
+
+	e = json_data_new_raw(d, NULL, text, len);
+	if (!e)
 		return -1;
+
+	if (at) {
+		TAILQ_INSERT_BEFORE(at, e, next);
+		e->parent = d;
+		d->nchild++;
+		json_data_changed(d);
+	} else {
+		json_data_put(d, NULL, e);
 	}
 
-	len = d->value.len - 2;
-	if (size <= len) {
-		printf("space is not enough to contain string (%zu bytes)\n", len);
+	return 0;
+}
+
+int json_data_replace_raw(json_data *d, int idx, const char *text, size_t len)
+{
+	json_data *old;
+	json_data *e;
+
+	if (!d || json_data_mutable(d, ARRAY))
+		return -1;
+
+	old = json_data_get_by_index(d, idx);
+	if (!old)
+		return -1;
+
+	e = json_data_new_raw(d, NULL, text, len);
+	if (!e)
+		return -1;
+	json_data_put(d, old, e);
+
+	return 0;
+}
+
+static int json_data_remove(json_data *d, json_data *e)
+{
+	if (!e)
+		return -1;
+
+	TAILQ_REMOVE(&d->head, e, next);
+	d->nchild--;
+	if (!json_data_is_arena(e))
+		json_data_free(e);
+	json_data_changed(d);
+
+	return 0;
+}
+
+int json_data_remove_by_name(json_data *d, const char *name)
+{
+	if (!d || !name || json_data_mutable(d, OBJECT))
+		return -1;
+	if (!json_name_valid(name)) {
+		json_error_set(JSON_ERR_ARG, "name is not escaped", NULL);
 		return -1;
 	}
 
-	if (len > 0)
-		memcpy(str, d->value.p+1, len);
-	str[len] = '\0';
+	return json_data_remove(d, json_data_get_by_name(d, name));
+}
 
-	return 0;
+int json_data_remove_by_index(json_data *d, int idx)
+{
+	if (!d || json_data_mutable(d, ARRAY))
+		return -1;
+
+	return json_data_remove(d, json_data_get_by_index(d, idx));
 }
 
 static int parse_head(char *begin, char *end, size_t *offset,
 	enum json_type *type)
 {
-	char *p = begin;
+	char *p;
 	int ret = 0;
 
-	while (p < end) {
-		if (!is_blank(*p) && !is_endofline(*p))
-			break;
-		p++;
-	}
+	p = (char *)json_scan_skip(begin, end, JSON_SCAN_BLANK);
 
 	if (p < end) {
 		if (offset)
@@ -405,286 +2186,997 @@ static int parse_head(char *begin, char *end, size_t *offset,
 			}
 		}
 	} else {
+		json_error_set(JSON_ERR_SYNTAX, "value is missing", end);
 		ret = -1;
 	}
 
-	return ret;
+	return ret;
+}
+
+/* parse buffer begin with '{' */
+static char *parse_object(char *begin, char *end)
+{
+	char *p = begin + 1;
+	int completed = 0;
+
+	while (p < end) {
+		if (is_blank(*p) || is_endofline(*p)) {
+			p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+			continue;
+		}
+		switch (*p) {
+		case '\"':
+			begin = p;
+			p = parse_string(begin, end);
+			if (p == (begin + 1)) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is empty", begin);
+				p = NULL;
+			}
+			break;
+		case ':':
+			begin = p + 1;
+			p = parse_value(begin, end, NULL, NULL, NULL);
+			break;
+		case '}':
+			completed = 1;
+			break;
+		default:
+			break;
+		}
+		if (!p || completed)
+			break;
+		p++;
+	}
+
+	/* a nested error has been recorded already */
+	if (p && !completed) {
+		json_error_set(JSON_ERR_SYNTAX, "'}' is missing", end);
+		p = NULL;
+	}
+
+	return p;
+}
+
+/* parse buffer begin with '[' */
+static char *parse_array(char *begin, char *end)
+{
+	char *p = begin;
+	int completed = 0;
+
+	while (p < end) {
+		if (is_blank(*p) || is_endofline(*p)) {
+			p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+			continue;
+		}
+		switch (*p) {
+		case '[':
+		case ',':
+			begin = p + 1;
+			p = parse_value(begin, end, NULL, NULL, NULL);
+			break;
+		case ']':
+			completed = 1;
+			break;
+		default:
+			break;
+		}
+		if (!p || completed)
+			break;
+		p++;
+	}
+
+	if (p && !completed) {
+		json_error_set(JSON_ERR_SYNTAX, "']' is missing", end);
+		p = NULL;
+	}
+
+	return p;
+}
+
+/* parse buffer begin with '"' */
+static char *parse_string(char *begin, char *end)
+{
+	char *p = begin + 1;
+
+	while (p < end) {
+		p = (char *)json_scan_find(p, end,
+			JSON_SCAN_QUOTE | JSON_SCAN_BACKSLASH);
+		if ((p < end) && (*p == '\"'))
+			return p;
+		/* skip the escaped character, it may be a '"' */
+		p += 2;
+	}
+
+	json_error_set(JSON_ERR_SYNTAX, "'\"' is missing", end);
+	return NULL;
+}
+
+/* buffer begin without '{', '[' and '"' */
+static char *parse_misc(char *begin, char *end)
+{
+	char *p;
+
+	p = (char *)json_scan_find(begin, end, JSON_SCAN_CLOSE | JSON_SCAN_COMMA);
+
+	/* drop the blanks between the value and its delimiter */
+	while ((p > begin) && (is_blank(*(p-1)) || is_endofline(*(p-1))))
+		p--;
+
+	return p - 1;
+}
+
+static char *parse_value(char *begin, char *end, size_t *offset, size_t *len,
+	enum json_type *type)
+{
+	char *p;
+	size_t o;
+	enum json_type t;
+
+	if (parse_head(begin, end, &o, &t))
+		return NULL;
+	begin += o;
+
+	switch (t) {
+	case OBJECT:
+		p = parse_object(begin, end);
+		break;
+	case ARRAY:
+		p = parse_array(begin, end);
+		break;
+	case STRING:
+		p = parse_string(begin, end);
+		break;
+	default:
+		p = parse_misc(begin, end);
+		break;
+	}
+
+	if (offset)
+		*offset = o;
+	if (len && p)
+		*len = p - begin + 1;
+	if (type)
+		*type = t;
+
+	return p;
+}
+
+char *json_value_end(char *begin, char *end, size_t *offset, size_t *len,
+	enum json_type *type)
+{
+	return parse_value(begin, end, offset, len, type);
+}
+
+char *json_string_end(char *begin, char *end)
+{
+	return parse_string(begin, end);
+}
+
+static int tape_push(struct json_doc *doc, enum json_type type, buf_t *name,
+	char *value, uint32_t *idx)
+{
+	struct json_tape *t;
+	unsigned char *types;
+	size_t size;
+
+	if (doc->ntape == doc->tape_size) {
+		size = doc->tape_size ? doc->tape_size * 2 : 64;
+		t = (struct json_tape *)realloc(doc->tape, size * sizeof(*t));
+		if (t)
+			doc->tape = t;
+		types = t ? (unsigned char *)realloc(doc->tape_type, size) : NULL;
+		if (!types) {
+			json_error_sys(JSON_ERR_NOMEM, "realloc tape error");
+			return -1;
+		}
+		doc->tape_type = types;
+		doc->tape_size = size;
+	}
+
+	doc->tape_type[doc->ntape] = type;
+	t = &doc->tape[doc->ntape];
+	/* a name follows a '{' or a ',', its offset is never 0 */
+	t->name = name ? name->p - doc->buf : 0;
+	t->value = value - doc->buf;
+	t->value_len = 0;
+	t->next = 0;
+	*idx = doc->ntape++;
+
+	return 0;
+}
+
+static char *tape_parse_value(struct json_doc *doc, char *begin, char *end,
+	buf_t *name);
+
+/* same grammar as parse_object(), recording members on the tape */
+static char *tape_parse_object(struct json_doc *doc, char *begin, char *end)
+{
+	char *p = begin + 1;
+	buf_t name = { NULL, 0 };
+	int completed = 0;
+
+	while (p < end) {
+		if (is_blank(*p) || is_endofline(*p)) {
+			p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+			continue;
+		}
+		switch (*p) {
+		case '\"':
+			begin = p;
+			p = parse_string(begin, end);
+			if (p == (begin + 1)) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is empty", begin);
+				p = NULL;
+			} else if (p) {
+				name.p = begin;
+				name.len = p - begin + 1;
+			}
+			break;
+		case ':':
+			if (!name.p) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is missing", p);
+				return NULL;
+			}
+			p = tape_parse_value(doc, p + 1, end, &name);
+			name.p = NULL;
+			break;
+		case '}':
+			completed = 1;
+			break;
+		default:
+			break;
+		}
+		if (!p || completed)
+			break;
+		p++;
+	}
+
+	if (p && !completed) {
+		json_error_set(JSON_ERR_SYNTAX, "'}' is missing", end);
+		p = NULL;
+	}
+
+	return p;
+}
+
+/* same grammar as parse_array(), recording elements on the tape */
+static char *tape_parse_array(struct json_doc *doc, char *begin, char *end)
+{
+	char *p = begin;
+	int completed = 0;
+
+	while (p < end) {
+		if (is_blank(*p) || is_endofline(*p)) {
+			p = (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+			continue;
+		}
+		switch (*p) {
+		case '[':
+		case ',':
+			p = tape_parse_value(doc, p + 1, end, NULL);
+			break;
+		case ']':
+			completed = 1;
+			break;
+		default:
+			break;
+		}
+		if (!p || completed)
+			break;
+		p++;
+	}
+
+	if (p && !completed) {
+		json_error_set(JSON_ERR_SYNTAX, "']' is missing", end);
+		p = NULL;
+	}
+
+	return p;
+}
+
+static char *tape_parse_value(struct json_doc *doc, char *begin, char *end,
+	buf_t *name)
+{
+	char *p;
+	size_t o;
+	uint32_t idx;
+	size_t len;
+	enum json_type t;
+
+	if (parse_head(begin, end, &o, &t))
+		return NULL;
+	begin += o;
+
+	if (tape_push(doc, t, name, begin, &idx))
+		return NULL;
+
+	switch (t) {
+	case OBJECT:
+		p = tape_parse_object(doc, begin, end);
+		break;
+	case ARRAY:
+		p = tape_parse_array(doc, begin, end);
+		break;
+	case STRING:
+		p = parse_string(begin, end);
+		break;
+	default:
+		p = parse_misc(begin, end);
+		break;
+	}
+	if (!p)
+		return NULL;
+
+	len = p - begin + 1;
+	if (len == 0) {
+		/* empty value, e.g. "a": , is dropped like the lazy parser does */
+		doc->ntape = idx;
+		return p;
+	}
+
+	doc->tape[idx].value_len = len;
+	doc->tape[idx].next = doc->ntape;
+
+	return p;
+}
+
+/*
+ * JSON_PARSE_PARALLEL: the structural characters and string quotes are
+ * found by json_index_build() on several threads, then the tape is built
+ * from their offsets alone. The entries are the ones tape_parse_value()
+ * records for the same input.
+ */
+struct tape_index {
+	size_t *pos;		/* ends with a sentinel at doc->len */
+	size_t n;
+	size_t i;		/* next offset to consume */
+};
+
+static char *tape_index_value(struct json_doc *doc, struct tape_index *x,
+	char *begin, buf_t *name);
+
+static char *tape_index_at(struct json_doc *doc, struct tape_index *x)
+{
+	return doc->buf + x->pos[x->i];
 }
 
-/* parse buffer begin with '{' */
-static char *parse_object(char *begin, char *end)
+/*
+ * the current offset is the '{' of the object, same grammar as
+ * tape_parse_object(): stray ',' are skipped, a name needs its ':'
+ */
+static char *tape_index_object(struct json_doc *doc, struct tape_index *x)
 {
-	char *p = begin + 1;
-	int completed = 0;
+	char *end = doc->buf + doc->len;
+	buf_t name = { NULL, 0 };
+	char *c;
 
-	while (p < end) {
-		if (is_blank(*p) || is_endofline(*p)) {
-			p++;
-			continue;
-		}
-		switch (*p) {
+	x->i++;
+	while ((c = tape_index_at(doc, x)) < end) {
+		switch (*c) {
 		case '\"':
-			begin = p;
-			p = parse_string(begin, end);
-			if (p == (begin + 1)) {
-				printf("'name' is empty\n");
-				p = NULL;
+			if (x->i + 1 >= x->n) {
+				json_error_set(JSON_ERR_SYNTAX, "'\"' is missing", end);
+				return NULL;
 			}
+			name.p = c;
+			name.len = doc->buf + x->pos[x->i + 1] - c + 1;
+			if (name.len == 2) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is empty", c);
+				return NULL;
+			}
+			x->i += 2;
 			break;
 		case ':':
-			begin = p + 1;
-			p = parse_value(begin, end, NULL, NULL, NULL);
+			if (!name.p) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is missing", c);
+				return NULL;
+			}
+			x->i++;
+			if (!tape_index_value(doc, x, c + 1, &name))
+				return NULL;
+			name.p = NULL;
 			break;
 		case '}':
-			completed = 1;
-			break;
+			x->i++;
+			return c;
 		default:
+			x->i++;
 			break;
 		}
-		if (!p || completed)
-			break;
-		p++;
 	}
 
-	if (!completed)
-		printf("'}' is missing\n");
-
-	return p;
+	json_error_set(JSON_ERR_SYNTAX, "'}' is missing", end);
+	return NULL;
 }
 
-/* parse buffer begin with '[' */
-static char *parse_array(char *begin, char *end)
+/* 'begin' points to '[', the current offset, grammar of tape_parse_array() */
+static char *tape_index_array(struct json_doc *doc, struct tape_index *x,
+	char *begin)
 {
-	char *p = begin;
-	int completed = 0;
+	char *end = doc->buf + doc->len;
+	char *c = begin;
 
-	while (p < end) {
-		if (is_blank(*p) || is_endofline(*p)) {
-			p++;
-			continue;
-		}
-		switch (*p) {
+	while (c < end) {
+		switch (*c) {
 		case '[':
 		case ',':
-			begin = p + 1;
-			p = parse_value(begin, end, NULL, NULL, NULL);
+			x->i++;
+			if (!tape_index_value(doc, x, c + 1, NULL))
+				return NULL;
 			break;
 		case ']':
-			completed = 1;
-			break;
+			x->i++;
+			return c;
 		default:
+			x->i++;
 			break;
 		}
-		if (!p || completed)
-			break;
-		p++;
+		c = tape_index_at(doc, x);
+	}
+
+	json_error_set(JSON_ERR_SYNTAX, "']' is missing", end);
+	return NULL;
+}
+
+static char *tape_index_value(struct json_doc *doc, struct tape_index *x,
+	char *begin, buf_t *name)
+{
+	char *end = doc->buf + doc->len;
+	char *p;
+	size_t o;
+	uint32_t idx;
+	size_t len;
+	enum json_type t;
+
+	if (parse_head(begin, end, &o, &t))
+		return NULL;
+	begin += o;
+
+	if (tape_push(doc, t, name, begin, &idx))
+		return NULL;
+
+	switch (t) {
+	case OBJECT:
+		p = tape_index_object(doc, x);
+		break;
+	case ARRAY:
+		p = tape_index_array(doc, x, begin);
+		break;
+	case STRING:
+		if (x->i + 1 >= x->n) {
+			json_error_set(JSON_ERR_SYNTAX, "'\"' is missing", end);
+			return NULL;
+		}
+		p = doc->buf + x->pos[x->i + 1];
+		x->i += 2;
+		break;
+	default:
+		/* up to the next delimiter as parse_misc(), without the blanks */
+		while (((p = tape_index_at(doc, x)) < end) && (*p != ',') &&
+			(*p != '}') && (*p != ']'))
+			x->i++;
+		while ((p > begin) && (is_blank(*(p-1)) || is_endofline(*(p-1))))
+			p--;
+		p--;
+		break;
+	}
+	if (!p)
+		return NULL;
+
+	len = p - begin + 1;
+	if (len == 0) {
+		/* empty value, dropped as tape_parse_value() does */
+		doc->ntape = idx;
+		return p;
 	}
 
-	if (!completed)
-		printf("']' is missing\n");
+	doc->tape[idx].value_len = len;
+	doc->tape[idx].next = doc->ntape;
 
 	return p;
 }
 
-/* parse buffer begin with '"' */
-static char *parse_string(char *begin, char *end)
+static char *tape_index_parse(struct json_doc *doc)
 {
-	char *p = begin + 1;
-	int completed = 0;
+	struct tape_index x = { NULL, 0, 0 };
+	char *p;
 
-	while (p < end) {
-		if (is_blank(*p) || is_endofline(*p)) {
-			p++;
-			continue;
+	x.pos = json_index_build(doc->buf, doc->len, parse_threads, &x.n);
+	if (!x.pos)
+		return NULL;
+
+	p = tape_index_value(doc, &x, doc->buf, NULL);
+	free(x.pos);
+
+	return p;
+}
+
+/*
+ * Projection parse, see json_path_parse(). Only the values reached by the
+ * steps get a node. Every other value is stepped over, containers through
+ * json_scan_close() which looks at quotes and brackets only. Containers
+ * on the way are built eagerly and marked parsed: objects with only the
+ * members wanted, arrays with their elements up to the last index wanted
+ * so that indexes keep their meaning.
+ */
+static char *proj_value(json_data *d, char *p, char *end, buf_t *name,
+	const struct json_proj *proj);
+
+static char *proj_blank(char *p, char *end)
+{
+	return (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+}
+
+/* last byte of the value at 'p', nothing is checked inside containers */
+static char *proj_skip(char *p, char *end)
+{
+	char *q;
+
+	switch (*p) {
+	case '{':
+	case '[':
+		q = (char *)json_scan_close(p + 1, end);
+		if (q == end) {
+			json_error_set(JSON_ERR_SYNTAX, (*p == '{') ?
+				"'}' is missing" : "']' is missing", end);
+			return NULL;
+		}
+		return q;
+	case '\"':
+		return parse_string(p, end);
+	default:
+		return parse_misc(p, end);
+	}
+}
+
+static const struct json_proj *proj_find(const struct json_proj *proj,
+	buf_t *name, long idx)
+{
+	for (; proj; proj = proj->next) {
+		if (name) {
+			if (proj->name && (proj->len + 2 == name->len) &&
+				!memcmp(proj->name, name->p + 1, proj->len))
+				return proj;
+		} else if (proj->idx == idx) {
+			return proj;
 		}
+	}
+
+	return NULL;
+}
+
+/* the value after ':' or ',' at 'p' is empty, e.g. "a": , or [1,,2] */
+static int proj_empty(char *p)
+{
+	return (*p == ',') || (*p == '}') || (*p == ']');
+}
+
+/*
+ * 'p' points to '{', returns its '}'. The grammar is the one of
+ * tape_parse_object(): stray ',' are skipped, a name needs its ':' and a
+ * ':' its name, members with an empty value are dropped.
+ */
+static char *proj_object(json_data *d, char *p, char *end,
+	const struct json_proj *proj)
+{
+	buf_t name = { NULL, 0 };
+	char *q;
+
+	for (p = proj_blank(p + 1, end); p < end; p = proj_blank(p + 1, end)) {
 		switch (*p) {
-		case '"':
-			completed = 1;
+		case '\"':
+			q = parse_string(p, end);
+			if (!q)
+				return NULL;
+			if (q == p + 1) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is empty", p);
+				return NULL;
+			}
+			name.p = p;
+			name.len = q - p + 1;
+			p = q;
 			break;
+		case ':':
+			if (!name.p) {
+				json_error_set(JSON_ERR_SYNTAX, "'name' is missing", p);
+				return NULL;
+			}
+			q = proj_blank(p + 1, end);
+			if (q >= end) {
+				json_error_set(JSON_ERR_SYNTAX, "value is missing", end);
+				return NULL;
+			}
+			if (proj_empty(q)) {
+				p = q - 1;
+			} else {
+				p = proj_value(d, q, end, &name,
+					proj_find(proj, &name, -1));
+				if (!p)
+					return NULL;
+			}
+			name.p = NULL;
+			break;
+		case '}':
+			return p;
 		default:
 			break;
 		}
-		if (completed)
-			break;
-		p++;
 	}
 
-	if (!completed)
-		printf("'\"' is missing\n");
-
-	return p;
+	json_error_set(JSON_ERR_SYNTAX, "'}' is missing", end);
+	return NULL;
 }
 
-/* buffer begin without '{', '[' and '"' */
-static char *parse_misc(char *begin, char *end)
+/*
+ * 'p' points to '[', returns its ']'. The grammar is the one of
+ * tape_parse_array(), empty values are dropped and take no index.
+ */
+static char *proj_array(json_data *d, char *p, char *end,
+	const struct json_proj *proj)
 {
-	char *p = begin;
-	int completed = 0;
-	int pads = 0;
+	const struct json_proj *s;
+	long last = -1;
+	long i = 0;
+	char *q;
+
+	for (s = proj; s; s = s->next) {
+		if (s->idx > last)
+			last = s->idx;
+	}
 
-	while (p < end) {
-		if (is_blank(*p) || is_endofline(*p)) {
-			pads++;
-			p++;
-			continue;
-		}
+	for (; p < end; p = proj_blank(p + 1, end)) {
 		switch (*p) {
-		case '}':
-		case ']':
+		case '[':
 		case ',':
-			completed = 1;
+			q = proj_blank(p + 1, end);
+			if (q >= end) {
+				json_error_set(JSON_ERR_SYNTAX, "value is missing", end);
+				return NULL;
+			}
+			if (proj_empty(q)) {
+				p = q - 1;
+				break;
+			}
+			/* nothing wanted further, the rest goes in one skip */
+			if (i > last) {
+				p = (char *)json_scan_close(q, end);
+				if (p == end)
+					goto err;
+				return p;
+			}
+			p = proj_value(d, q, end, NULL, proj_find(proj, NULL, i));
+			if (!p)
+				return NULL;
+			i++;
 			break;
+		case ']':
+			return p;
 		default:
-			pads = 0;
 			break;
 		}
-		if (completed)
-			break;
-		p++;
 	}
 
-	return p - pads - 1;
+err:
+	json_error_set(JSON_ERR_SYNTAX, "']' is missing", end);
+	return NULL;
 }
 
-static char *parse_value(char *begin, char *end, size_t *offset, size_t *len,
-	enum json_type *type)
+/*
+ * the value at 'p' is a member of 'd', it gets a node when 'proj' wants
+ * it or when 'd' is an array, returns its last byte
+ */
+static char *proj_value(json_data *d, char *p, char *end, buf_t *name,
+	const struct json_proj *proj)
 {
-	char *p;
-	buf_t buf;
-	size_t o;
-	enum json_type t;
+	size_t offset;
+	size_t len;
+	enum json_type type;
+	json_data *e;
+	char *q;
 
-	if (parse_head(begin, end, &o, &t))
+	if (!proj && name)
+		return proj_skip(p, end);
+
+	if (!proj) {
+		/* an element before the last one wanted, only its bounds */
+		q = proj_skip(p, end);
+		if (!q || parse_head(p, end, &offset, &type))
+			return NULL;
+		len = q - p + 1;
+	} else if (!proj->child || ((*p != '{') && (*p != '['))) {
+		/* a lazy node, its subtree is checked like a normal parse */
+		q = parse_value(p, end, &offset, &len, &type);
+		if (!q)
+			return NULL;
+	} else {
+		type = (*p == '{') ? OBJECT : ARRAY;
+		q = NULL;
+	}
+
+	if (q && (len == 0)) {
+		json_error_set(JSON_ERR_SYNTAX, "value is missing", p);
 		return NULL;
-	begin += o;
+	}
 
-	switch (t) {
-	case OBJECT:
-		p = parse_object(begin, end);
-		break;
-	case ARRAY:
-		p = parse_array(begin, end);
-		break;
-	case STRING:
-		p = parse_string(begin, end);
-		break;
-	default:
-		p = parse_misc(begin, end);
-		break;
+	if (json_data_full(d, p))
+		return NULL;
+	e = json_data_alloc(d->doc);
+	if (!e)
+		return NULL;
+	e->type = type;
+	if (name)
+		e->name = *name;
+	e->value.p = p;
+	json_data_add(d, e);
+	if (q) {
+		e->value.len = len;
+		return q;
 	}
 
-	if (offset)
-		*offset = o;
-	if (len && p)
-		*len = p - begin + 1;
-	if (type)
-		*type = t;
+	q = (type == OBJECT) ? proj_object(e, p, end, proj->child) :
+		proj_array(e, p, end, proj->child);
+	if (!q)
+		return NULL;
+	e->value.len = q - p + 1;
+	if ((type == ARRAY) && e->nchild && json_vec_build(e))
+		return NULL;
+	e->parsed = 1;
 
-	return p;
+	return q;
+}
+
+static json_data *json_doc_parse_proj(struct json_doc *doc,
+	const struct json_proj *proj)
+{
+	char *end = doc->buf + doc->len;
+	char *p, *q;
+	json_data *d;
+
+	p = proj_blank(doc->buf, end);
+	if (p >= end) {
+		json_error_set(JSON_ERR_SYNTAX, "value is missing", p);
+		return NULL;
+	}
+	if ((*p != '{') && (*p != '[')) {
+		json_error_set(JSON_ERR_TYPE, "json data is not object or array",
+			p);
+		return NULL;
+	}
+
+	d = json_data_alloc(doc);
+	if (!d)
+		return NULL;
+	d->type = (*p == '{') ? OBJECT : ARRAY;
+	d->value.p = p;
+	d->root = 1;
+
+	q = (d->type == OBJECT) ? proj_object(d, p, end, proj) :
+		proj_array(d, p, end, proj);
+	if (q) {
+		d->value.len = q - p + 1;
+		if ((d->type == ARRAY) && d->nchild && json_vec_build(d))
+			q = NULL;
+	}
+	if (!q) {
+		/* the caller releases the document */
+		d->root = 0;
+		json_data_free(d);
+		return NULL;
+	}
+	d->parsed = 1;
+
+	return d;
 }
 
-static json_data *json_data_from_buf(buf_t *buf)
+static json_data *json_doc_parse(struct json_doc *doc,
+	const struct json_proj *proj)
 {
+	char *buf = doc->buf;
 	char *end;
 	size_t offset;
 	size_t len;
 	enum json_type type;
 	json_data *d;
 
-	end = parse_value(buf->p, buf->p + buf->len, &offset, &len, &type);
-	if (!end || (len == 0))
-		return NULL;
+	JSON_STAT_ADD(bytes_scanned, doc->len);
+	if (doc->flags & JSON_PARSE_UTF8) {
+		end = (char *)json_scan_utf8(buf, buf + doc->len);
+		if (end != buf + doc->len) {
+			json_error_set(JSON_ERR_UTF8, "invalid UTF-8", end);
+			return NULL;
+		}
+	}
+
+	if (proj)
+		return json_doc_parse_proj(doc, proj);
 
-	d = json_data_alloc();
-	if (d) {
-		d->type = type;
-		d->value.p = buf->p + offset;
-		d->value.len = len;
+	if ((doc->flags & (JSON_PARSE_INDEX | JSON_PARSE_PARALLEL)) &&
+		(doc->len <= TAPE_MAX_LEN)) {
+		/* one chunk is faster with the sequential parser */
+		if ((doc->flags & JSON_PARSE_PARALLEL) &&
+			(json_index_chunks(doc->len, parse_threads) > 1))
+			end = tape_index_parse(doc);
+		else
+			end = tape_parse_value(doc, buf, buf + doc->len, NULL);
+		if (!end || !doc->ntape)
+			return NULL;
+		type = (enum json_type)doc->tape_type[0];
+		offset = doc->tape[0].value;
+		len = doc->tape[0].value_len;
+	} else {
+		end = parse_value(buf, buf + doc->len, &offset, &len, &type);
+		if (!end || (len == 0))
+			return NULL;
 	}
 
+	d = json_data_alloc(doc);
+	if (!d)
+		return NULL;
+	d->type = type;
+	d->value.p = buf + offset;
+	d->value.len = len;
+	d->root = 1;
+	if (doc->tape)
+		d->tape = 0;
+
 	return d;
 }
 
-json_data *json_data_from_string(const char *str)
+/* parse doc->buf, the document is released by the caller on failure */
+static json_data *json_data_from_doc(struct json_doc *doc,
+	const struct json_proj *proj)
 {
-	buf_t b;
+	struct json_error_input in;
 	json_data *d;
 
-	if (!str) {
-		printf("string is not specified\n");
+	json_error_enter(&in, doc->buf, doc->buf + doc->len);
+	d = json_doc_parse(doc, proj);
+	json_error_leave(&in);
+
+	return d;
+}
+
+json_data *json_data_from_mem_proj(const char *buf, size_t len,
+	unsigned int flags, const struct json_proj *proj)
+{
+	struct json_doc *doc;
+	json_data *d;
+
+	if (!buf || (len == 0)) {
+		json_error_set(JSON_ERR_ARG, "buffer is empty", NULL);
 		return NULL;
 	}
 
-	b.len = strlen(str);
-	if (b.len == 0) {
-		printf("string is empty\n");
+	/* there is no file to map, the input is always copied */
+	flags &= ~JSON_PARSE_MMAP;
+	/* a projection has no tape, it builds its nodes while it scans */
+	if (proj)
+		flags &= ~(JSON_PARSE_INDEX | JSON_PARSE_PARALLEL |
+			JSON_PARSE_COMPACT);
+
+	doc = json_doc_new(len, flags);
+	if (!doc)
+		return NULL;
+
+	memcpy(doc->buf, buf, len);
+
+	d = json_data_from_doc(doc, proj);
+	if (!d)
+		json_doc_free(doc);
+
+	return d;
+}
+
+json_data *json_data_from_mem(const char *buf, size_t len, unsigned int flags)
+{
+	return json_data_from_mem_proj(buf, len, flags, NULL);
+}
+
+json_data *json_data_from_string_ex(const char *str, unsigned int flags)
+{
+	size_t len;
+
+	if (!str) {
+		json_error_set(JSON_ERR_ARG, "string is not specified", NULL);
 		return NULL;
 	}
 
-	b.p = (char *)malloc(b.len);
-	if (!b.p) {
-		perror("malloc buf error");
+	len = strlen(str);
+	if (len == 0) {
+		json_error_set(JSON_ERR_ARG, "string is empty", NULL);
 		return NULL;
 	}
 
-	memcpy(b.p, str, b.len);
+	return json_data_from_mem(str, len, flags);
+}
+
+json_data *json_data_from_string(const char *str)
+{
+	return json_data_from_string_ex(str, 0);
+}
+
+/* map the whole file read-only as doc->buf, the pages are never written */
+static int json_doc_map(struct json_doc *doc, int fd)
+{
+	void *p;
+
+	p = mmap(NULL, doc->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		json_error_sys(JSON_ERR_IO, "mmap error");
+		return -1;
+	}
 
-	d = json_data_from_buf(&b);
-	if (d)
-		d->buf = b.p;
+	/* hints only, the parse works the same when they are refused */
+	madvise(p, doc->len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(p, doc->len, MADV_HUGEPAGE);
+#endif
+	doc->buf = (char *)p;
 
-	return d;
+	return 0;
 }
 
-json_data *json_data_from_file(const char *file)
+json_data *json_data_from_file_ex(const char *file, unsigned int flags)
 {
 	int fd;
 	ssize_t n;
-	buf_t b;
+	size_t len;
+	struct json_doc *doc;
 	json_data *d = NULL;
 
 	if (!file) {
-		printf("file is not specified\n");
+		json_error_set(JSON_ERR_ARG, "file is not specified", NULL);
 		return NULL;
 	}
 
 	fd = open(file, O_RDONLY);
 	if (fd < 0) {
-		perror("open error");
+		json_error_sys(JSON_ERR_IO, "open error");
 		return NULL;
 	}
 
-	b.len = lseek(fd, 0, SEEK_END);
-	if (!b.len) {
-		printf("file '%s' is empty\n", file);
+	len = lseek(fd, 0, SEEK_END);
+	if (!len) {
+		json_error_set(JSON_ERR_ARG, "file is empty", NULL);
 		goto end;
 	}
 
-	b.p = (char *)malloc(b.len);
-	if (!b.p) {
-		perror("malloc buf error");
+	doc = json_doc_new(len, flags);
+	if (!doc)
 		goto end;
+
+	if (flags & JSON_PARSE_MMAP) {
+		if (json_doc_map(doc, fd)) {
+			json_doc_free(doc);
+			goto end;
+		}
+		goto parse;
 	}
 
 	lseek(fd, 0, SEEK_SET);
-	n = read(fd, b.p, b.len);
+	n = read(fd, doc->buf, len);
 	if (n < 0) {
-		perror("read error");
-		free(b.p);
+		json_error_sys(JSON_ERR_IO, "read error");
+		json_doc_free(doc);
 		goto end;
 	}
-	if (n != (ssize_t)b.len) {
-		printf("read %zd bytes data which is less than file size %zu",
-			n, b.len);
-		free(b.p);
+	if (n != (ssize_t)len) {
+		json_error_set(JSON_ERR_IO, "file is shorter than its size", NULL);
+		json_doc_free(doc);
 		goto end;
 	}
 
-	d = json_data_from_buf(&b);
-	if (d)
-		d->buf = b.p;
+parse:
+	d = json_data_from_doc(doc, NULL);
+	if (!d)
+		json_doc_free(doc);
 
 end:
 	close(fd);
 	return d;
 }
+
+json_data *json_data_from_file(const char *file)
+{
+	return json_data_from_file_ex(file, 0);
+}
@@ -15,30 +15,141 @@ enum json_type {
 	MISC
 };
 
+/* flags for json_data_from_string_ex()/json_data_from_file_ex() */
+enum json_parse_flags {
+	JSON_PARSE_INDEX = 1 << 0,	/* build structural index in one pass */
+	JSON_PARSE_ARENA = 1 << 1,	/* nodes and buffer in a per-doc arena */
+	JSON_PARSE_MMAP = 1 << 2,	/* parse the file in place, no copy */
+	JSON_PARSE_UTF8 = 1 << 3,	/* reject input that is not UTF-8 */
+	JSON_PARSE_PARALLEL = 1 << 4,	/* JSON_PARSE_INDEX built on threads */
+	JSON_PARSE_COMPACT = 1 << 5,	/* nodes built only for values reached */
+};
+
 typedef struct {
 	char *p;
 	size_t len;
 } buf_t;
 
+/*
+ * The library does no I/O on errors. A failing call records what went
+ * wrong in a per-thread slot, read back with json_last_error(). The slot
+ * is only meaningful right after a call reported a failure.
+ */
+enum json_error_code {
+	JSON_OK = 0,
+	JSON_ERR_ARG,		/* NULL, empty or out of range argument */
+	JSON_ERR_NOMEM,
+	JSON_ERR_IO,		/* open, read, write or mmap, see 'sys' */
+	JSON_ERR_SYNTAX,
+	JSON_ERR_TYPE,		/* the value has another type */
+	JSON_ERR_RANGE,		/* the number does not fit */
+	JSON_ERR_SPACE,		/* the output buffer is too small */
+	JSON_ERR_ESCAPE,	/* bad escape sequence in a string */
+	JSON_ERR_UTF8,
+	JSON_ERR_FROZEN,	/* the document cannot be modified */
+	JSON_ERR_LIMIT,		/* more elements than the destination holds */
+};
+
+struct json_error {
+	enum json_error_code code;
+	const char *msg;	/* static text, never NULL */
+	int sys;		/* errno of JSON_ERR_IO and JSON_ERR_NOMEM */
+	/* position in the input of syntax errors, line and column from 1 */
+	int has_pos;
+	size_t offset;
+	size_t line;
+	size_t column;
+};
+
+struct json_doc;
+struct json_hash;
+struct json_kids;
+
 TAILQ_HEAD(json_list, _json_data);
 
+/*
+ * 104 bytes on 64-bit. The flags and the 32-bit counts share two words,
+ * the name index, the element vector, the decoded string and the tape
+ * children are alternatives kept behind one pointer. With
+ * JSON_PARSE_COMPACT a document stays a tape of 17 bytes per value and
+ * get_by_name()/get_by_index() build a node for the child they return
+ * only. get_count() builds them all, so that 'head' can be walked.
+ */
 typedef struct _json_data {
 	TAILQ_ENTRY(_json_data) next;
 	enum json_type type;
-	char *buf;
+	unsigned char parsed;		/* children are materialized */
+	unsigned char dirty;		/* the subtree differs from the input */
+	unsigned char root;		/* owns 'doc', see json_data_free() */
+	unsigned char own;		/* text is a copy made by mutation */
+	uint32_t tape;			/* entry of JSON_PARSE_INDEX */
+	uint32_t nchild;
 	buf_t name;
 	buf_t value;
 	struct json_list head;
+	struct json_doc *doc;
+	struct _json_data *parent;
+	union {
+		struct json_hash *hash;		/* name index of large objects */
+		struct _json_data **vec;	/* elements of arrays */
+		char *str;		/* decoded copy of escaped strings */
+		struct json_kids *kids;	/* children reached, JSON_PARSE_COMPACT */
+	};
 } json_data;
 
 void print_buf(buf_t *buf);
+const struct json_error *json_last_error(void);
+void json_clear_error(void);
 json_data *json_data_get_by_name(json_data *item, const char *name);
 json_data *json_data_get_by_index(json_data *item, int idx);
+void json_data_set_hash_min(size_t members);
+/* threads used by JSON_PARSE_PARALLEL, <= 0 for one per online CPU */
+void json_data_set_parse_threads(int nthreads);
+int json_data_get_count(json_data *item);
+int json_data_freeze(json_data *obj);
+uint64_t json_data_doc_id(json_data *obj);
+/*
+ * 'name' is the text between the quotes, escaped as in the document, a
+ * '"', a bad escape or a control byte fails with JSON_ERR_ARG
+ */
+int json_data_set_raw(json_data *obj, const char *name, const char *text,
+	size_t len);
+int json_data_insert_raw(json_data *arr, int idx, const char *text,
+	size_t len);
+int json_data_replace_raw(json_data *arr, int idx, const char *text,
+	size_t len);
+int json_data_remove_by_name(json_data *obj, const char *name);
+int json_data_remove_by_index(json_data *arr, int idx);
 int json_data_to_long(json_data *item, long *val);
 int json_data_to_ulong(json_data *item, unsigned long *val);
+int json_data_to_int64(json_data *item, int64_t *val);
+int json_data_to_uint64(json_data *item, uint64_t *val);
+int json_data_to_double(json_data *item, double *val);
+/*
+ * Every element of the array 'item' into 'vals', which has room for 'max'
+ * of them, in one pass over the text without building nodes. '*n' is the
+ * number of elements, or on failure the index of the first element that
+ * could not be stored, the ones before it are decoded.
+ */
+int json_data_to_int64_array(json_data *item, int64_t *vals, size_t max,
+	size_t *n);
+int json_data_to_uint64_array(json_data *item, uint64_t *vals, size_t max,
+	size_t *n);
+int json_data_to_double_array(json_data *item, double *vals, size_t max,
+	size_t *n);
+/* decodes the escapes, the copy is NUL terminated */
 int json_data_to_string(json_data *item, char *str, size_t size);
+/*
+ * the text between the quotes when there is no escape, else a copy
+ * decoded on the first call, or by json_data_freeze(), and kept by the
+ * document until it is freed, not NUL terminated
+ */
+int json_data_get_string(json_data *item, buf_t *str);
 json_data *json_data_from_string(const char *str);
 json_data *json_data_from_file(const char *file);
+json_data *json_data_from_string_ex(const char *str, unsigned int flags);
+json_data *json_data_from_file_ex(const char *file, unsigned int flags);
+json_data *json_data_from_mem(const char *buf, size_t len, unsigned int flags);
 json_data *json_data_get(json_data *obj);
 void json_data_free(json_data *obj);
 
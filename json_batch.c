@@ -0,0 +1,304 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "json_batch.h"
+#include "json_int.h"
+#include "json_scan.h"
+
+struct batch_worker {
+	pthread_t tid;
+	const char *begin;
+	const char *end;
+	size_t nrec;		/* records in [begin, end) */
+	size_t base;		/* number of the first record */
+	unsigned int flags;
+	json_batch_cb cb;
+	void *arg;
+	json_data **docs;	/* output array when 'cb' is not set */
+	int *stop;
+	int ret;
+};
+
+/* end of the record starting at 'p', the '\n' is not part of it */
+static const char *batch_eol(const char *p, const char *end)
+{
+	const char *q = (const char *)memchr(p, '\n', end - p);
+
+	return q ? q : end;
+}
+
+static int batch_blank(const char *p, const char *eol)
+{
+	return json_scan_skip(p, eol, JSON_SCAN_BLANK) == eol;
+}
+
+static void *batch_count(void *data)
+{
+	struct batch_worker *w = (struct batch_worker *)data;
+	const char *p, *eol;
+
+	for (p = w->begin; p < w->end; p = eol + 1) {
+		eol = batch_eol(p, w->end);
+		if (!batch_blank(p, eol))
+			w->nrec++;
+	}
+
+	return NULL;
+}
+
+/* one value per record, anything but blanks after it fails the record */
+static json_data *batch_record(const char *p, const char *eol,
+	unsigned int flags)
+{
+	struct json_error_input in;
+	const char *rest;
+	json_data *d;
+
+	d = json_data_from_mem(p, eol - p, flags);
+	if (!d)
+		return NULL;
+
+	/* the document holds a copy of the record */
+	rest = p + (d->value.p - json_data_doc_text(d)) + d->value.len;
+	if (!batch_blank(rest, eol)) {
+		json_error_enter(&in, p, eol);
+		json_error_set(JSON_ERR_SYNTAX, "data after the value",
+			json_scan_skip(rest, eol, JSON_SCAN_BLANK));
+		json_error_leave(&in);
+		json_data_free(d);
+		return NULL;
+	}
+
+	return d;
+}
+
+static void *batch_parse(void *data)
+{
+	struct batch_worker *w = (struct batch_worker *)data;
+	const char *p, *eol;
+	size_t idx = w->base;
+	json_data *d;
+
+	for (p = w->begin; p < w->end; p = eol + 1) {
+		if (__atomic_load_n(w->stop, __ATOMIC_RELAXED))
+			break;
+		eol = batch_eol(p, w->end);
+		if (batch_blank(p, eol))
+			continue;
+		d = batch_record(p, eol, w->flags);
+		if (w->cb) {
+			if (w->cb(w->arg, idx, d)) {
+				__atomic_store_n(w->stop, 1, __ATOMIC_RELAXED);
+				w->ret = -1;
+			}
+		} else {
+			w->docs[idx] = d;
+		}
+		idx++;
+	}
+
+	return NULL;
+}
+
+/* run 'fn' on every worker, the first one on the calling thread */
+static int batch_run(struct batch_worker *w, int n, void *(*fn)(void *))
+{
+	int i, started, err;
+	int ret = 0;
+
+	for (started = 1; started < n; started++) {
+		err = pthread_create(&w[started].tid, NULL, fn, &w[started]);
+		if (err) {
+			/* the error is returned, errno is left alone */
+			errno = err;
+			json_error_sys(JSON_ERR_NOMEM, "pthread_create error");
+			ret = -1;
+			break;
+		}
+	}
+	fn(&w[0]);
+	for (i = 1; i < started; i++)
+		pthread_join(w[i].tid, NULL);
+
+	return ret;
+}
+
+static struct batch_worker *batch_split(const char *buf, size_t len,
+	int *nthreads)
+{
+	struct batch_worker *w;
+	const char *p, *end = buf + len;
+	int i, n = *nthreads;
+
+	if (n <= 0)
+		n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (n <= 0)
+		n = 1;
+	/* small inputs are not worth a thread each */
+	if ((size_t)n > len / 4096 + 1)
+		n = (int)(len / 4096 + 1);
+
+	w = (struct batch_worker *)calloc(n, sizeof(*w));
+	if (!w) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc batch error");
+		return NULL;
+	}
+
+	/* equal byte ranges, each moved forward to the next record start */
+	w[0].begin = buf;
+	for (i = 1; i < n; i++) {
+		p = buf + len / n * i;
+		if (p < w[i - 1].begin)
+			p = w[i - 1].begin;
+		if ((p > buf) && (p[-1] != '\n'))
+			p = batch_eol(p, end) + 1;
+		if (p > end)
+			p = end;
+		w[i].begin = p;
+		w[i - 1].end = p;
+	}
+	w[n - 1].end = end;
+	*nthreads = n;
+
+	return w;
+}
+
+static int batch_do(const char *buf, size_t len, unsigned int flags,
+	int nthreads, json_batch_cb cb, void *arg, json_data ***docs,
+	size_t *ndocs)
+{
+	struct batch_worker *w;
+	size_t total = 0;
+	int stop = 0;
+	int i, ret = -1;
+
+	w = batch_split(buf, len, &nthreads);
+	if (!w)
+		return -1;
+
+	if (batch_run(w, nthreads, batch_count))
+		goto end;
+
+	for (i = 0; i < nthreads; i++) {
+		w[i].base = total;
+		total += w[i].nrec;
+		w[i].flags = flags;
+		w[i].cb = cb;
+		w[i].arg = arg;
+		w[i].stop = &stop;
+	}
+
+	if (docs) {
+		*docs = (json_data **)calloc(total ? total : 1, sizeof(**docs));
+		if (!*docs) {
+			json_error_sys(JSON_ERR_NOMEM, "malloc batch docs error");
+			goto end;
+		}
+		for (i = 0; i < nthreads; i++)
+			w[i].docs = *docs;
+	}
+
+	if (batch_run(w, nthreads, batch_parse)) {
+		/* some records were parsed on the calling thread only */
+		if (docs) {
+			json_batch_free(*docs, total);
+			*docs = NULL;
+		}
+		goto end;
+	}
+
+	ret = 0;
+	for (i = 0; i < nthreads; i++)
+		if (w[i].ret)
+			ret = -1;
+	if (ndocs)
+		*ndocs = total;
+
+end:
+	free(w);
+	return ret;
+}
+
+int json_batch_parse_cb(const char *buf, size_t len, unsigned int flags,
+	int nthreads, json_batch_cb cb, void *arg)
+{
+	if (!buf || !cb) {
+		json_error_set(JSON_ERR_ARG, "buffer or callback is not specified",
+			NULL);
+		return -1;
+	}
+
+	return batch_do(buf, len, flags, nthreads, cb, arg, NULL, NULL);
+}
+
+json_data **json_batch_parse(const char *buf, size_t len, unsigned int flags,
+	int nthreads, size_t *ndocs)
+{
+	json_data **docs = NULL;
+
+	if (!buf || !ndocs) {
+		json_error_set(JSON_ERR_ARG, "buffer is not specified", NULL);
+		return NULL;
+	}
+
+	if (batch_do(buf, len, flags, nthreads, NULL, NULL, &docs, ndocs))
+		return NULL;
+
+	return docs;
+}
+
+json_data **json_batch_from_file(const char *file, unsigned int flags,
+	int nthreads, size_t *ndocs)
+{
+	int fd;
+	size_t len;
+	void *p;
+	json_data **docs = NULL;
+
+	if (!file || !ndocs) {
+		json_error_set(JSON_ERR_ARG, "file is not specified", NULL);
+		return NULL;
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		json_error_sys(JSON_ERR_IO, "open error");
+		return NULL;
+	}
+
+	len = lseek(fd, 0, SEEK_END);
+	if (!len) {
+		json_error_set(JSON_ERR_ARG, "file is empty", NULL);
+		goto end;
+	}
+
+	/* every record is copied into its own document, the map is temporary */
+	p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		json_error_sys(JSON_ERR_IO, "mmap error");
+		goto end;
+	}
+	madvise(p, len, MADV_SEQUENTIAL);
+
+	docs = json_batch_parse((const char *)p, len, flags & ~JSON_PARSE_MMAP,
+		nthreads, ndocs);
+	munmap(p, len);
+
+end:
+	close(fd);
+	return docs;
+}
+
+void json_batch_free(json_data **docs, size_t ndocs)
+{
+	size_t i;
+
+	if (docs) {
+		for (i = 0; i < ndocs; i++)
+			json_data_free(docs[i]);
+		free(docs);
+	}
+}
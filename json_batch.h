@@ -0,0 +1,36 @@
+#ifndef __JSON_BATCH_H__
+#define __JSON_BATCH_H__
+
+#include "json.h"
+
+/*
+ * Newline-delimited documents (NDJSON) parsed on a pool of threads. The
+ * input is cut into one byte range per thread at record boundaries, blank
+ * lines are skipped. A record holds one value, a line with more than one
+ * fails as a record, json_push splits concatenated values.
+ */
+
+/*
+ * Called from the worker threads with the record number in the input and
+ * its document, NULL when the record does not parse. json_last_error()
+ * then tells why, its positions count from the start of the record. The
+ * callee owns 'd'.
+ */
+typedef int (*json_batch_cb)(void *arg, size_t idx, json_data *d);
+
+/* 'nthreads' <= 0 uses one thread per online CPU */
+int json_batch_parse_cb(const char *buf, size_t len, unsigned int flags,
+	int nthreads, json_batch_cb cb, void *arg);
+
+/*
+ * documents in input order, NULL entries for the records that failed.
+ * Their errors stay with the worker threads, json_batch_parse_cb() sees
+ * them.
+ */
+json_data **json_batch_parse(const char *buf, size_t len, unsigned int flags,
+	int nthreads, size_t *ndocs);
+json_data **json_batch_from_file(const char *file, unsigned int flags,
+	int nthreads, size_t *ndocs);
+void json_batch_free(json_data **docs, size_t ndocs);
+
+#endif /* __JSON_BATCH_H__ */
@@ -0,0 +1,361 @@
+#include <fcntl.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "json_bind.h"
+#include "json_int.h"
+#include "json_scan.h"
+
+static char *bind_value(char *p, char *end, const struct json_bind_field *f,
+	char *base);
+
+static char *bind_blank(char *p, char *end)
+{
+	return (char *)json_scan_skip(p, end, JSON_SCAN_BLANK);
+}
+
+static const struct json_bind_field *bind_find(
+	const struct json_bind_field *fields, const char *name, size_t len)
+{
+	for (; fields->name; fields++) {
+		if (!strncmp(fields->name, name, len) && !fields->name[len])
+			return fields;
+	}
+
+	return NULL;
+}
+
+/* the value at 'p' is not wanted, only find where it ends */
+static char *bind_skip(char *p, char *end)
+{
+	size_t len = 0;
+
+	p = json_value_end(p, end, NULL, &len, NULL);
+	if (!p || (p >= end) || (len == 0)) {
+		json_error_set(JSON_ERR_SYNTAX, "value is incomplete", end);
+		return NULL;
+	}
+
+	return p + 1;
+}
+
+static int bind_int(char *dst, size_t size, int64_t v)
+{
+	int8_t v8 = (int8_t)v;
+	int16_t v16 = (int16_t)v;
+	int32_t v32 = (int32_t)v;
+
+	switch (size) {
+	case 1:
+		if (v8 != v)
+			return -1;
+		memcpy(dst, &v8, size);
+		break;
+	case 2:
+		if (v16 != v)
+			return -1;
+		memcpy(dst, &v16, size);
+		break;
+	case 4:
+		if (v32 != v)
+			return -1;
+		memcpy(dst, &v32, size);
+		break;
+	case 8:
+		memcpy(dst, &v, size);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+static int bind_uint(char *dst, size_t size, uint64_t v)
+{
+	uint8_t v8 = (uint8_t)v;
+	uint16_t v16 = (uint16_t)v;
+	uint32_t v32 = (uint32_t)v;
+
+	switch (size) {
+	case 1:
+		if (v8 != v)
+			return -1;
+		memcpy(dst, &v8, size);
+		break;
+	case 2:
+		if (v16 != v)
+			return -1;
+		memcpy(dst, &v16, size);
+		break;
+	case 4:
+		if (v32 != v)
+			return -1;
+		memcpy(dst, &v32, size);
+		break;
+	case 8:
+		memcpy(dst, &v, size);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+static char *bind_scalar(char *p, char *end, const struct json_bind_field *f,
+	char *dst)
+{
+	json_data d;
+	size_t offset;
+	int64_t i;
+	uint64_t u;
+	double v;
+	float fv;
+	int ret = -1;
+	int range = 0;
+	char *q;
+
+	memset(&d, 0, sizeof(d));
+	q = json_value_end(p, end, &offset, &d.value.len, &d.type);
+	if (!q || (q >= end) || (d.value.len == 0)) {
+		json_error_set(JSON_ERR_SYNTAX, "value is incomplete", end);
+		return NULL;
+	}
+	d.value.p = p + offset;
+
+	switch (f->type) {
+	case JSON_BIND_INT:
+		if (!json_data_to_int64(&d, &i))
+			ret = range = bind_int(dst, f->size, i);
+		break;
+	case JSON_BIND_UINT:
+		if (!json_data_to_uint64(&d, &u))
+			ret = range = bind_uint(dst, f->size, u);
+		break;
+	case JSON_BIND_DOUBLE:
+		if (json_data_to_double(&d, &v))
+			break;
+		if (f->size == sizeof(double)) {
+			memcpy(dst, &v, sizeof(v));
+			ret = 0;
+		} else if (f->size == sizeof(float)) {
+			fv = (float)v;
+			/* a finite double past FLT_MAX does not fit */
+			if (isinf(fv) && !isinf(v)) {
+				range = -1;
+				break;
+			}
+			memcpy(dst, &fv, sizeof(fv));
+			ret = 0;
+		} else {
+			range = -1;
+		}
+		break;
+	case JSON_BIND_STRING:
+		ret = json_data_to_string(&d, dst, f->size);
+		break;
+	default:
+		break;
+	}
+
+	/* a conversion that failed has set its own error already */
+	if (range)
+		json_error_set(JSON_ERR_RANGE, "value does not fit the field",
+			d.value.p);
+	if (ret)
+		return NULL;
+
+	return q + 1;
+}
+
+/* 'p' points to '{' */
+static char *bind_object(char *p, char *end,
+	const struct json_bind_field *fields, char *base)
+{
+	const struct json_bind_field *f;
+	char *q;
+
+	p = bind_blank(p + 1, end);
+	if ((p < end) && (*p == '}'))
+		return p + 1;
+
+	while (p < end) {
+		if (*p != '\"') {
+			json_error_set(JSON_ERR_SYNTAX, "'name' is missing", p);
+			return NULL;
+		}
+		q = json_string_end(p, end);
+		if (!q || (q >= end)) {
+			json_error_set(JSON_ERR_SYNTAX, "'\"' is missing", end);
+			return NULL;
+		}
+		f = bind_find(fields, p + 1, q - p - 1);
+
+		p = bind_blank(q + 1, end);
+		if ((p >= end) || (*p != ':')) {
+			json_error_set(JSON_ERR_SYNTAX, "':' is missing", p);
+			return NULL;
+		}
+		p = bind_blank(p + 1, end);
+		p = f ? bind_value(p, end, f, base) : bind_skip(p, end);
+		if (!p)
+			return NULL;
+
+		p = bind_blank(p, end);
+		if ((p < end) && (*p == '}'))
+			return p + 1;
+		if ((p >= end) || (*p != ',')) {
+			json_error_set(JSON_ERR_SYNTAX, "'}' is missing", p);
+			return NULL;
+		}
+		p = bind_blank(p + 1, end);
+	}
+
+	json_error_set(JSON_ERR_SYNTAX, "'}' is missing", end);
+	return NULL;
+}
+
+/* 'p' points to '[' */
+static char *bind_array(char *p, char *end, const struct json_bind_field *f,
+	char *base)
+{
+	char *dst = base + f->offset;
+	size_t n = 0;
+
+	p = bind_blank(p + 1, end);
+	if ((p < end) && (*p == ']'))
+		goto done;
+
+	while (p < end) {
+		if (n == f->max) {
+			json_error_set(JSON_ERR_LIMIT,
+				"array has more elements than the field", p);
+			return NULL;
+		}
+		p = bind_value(p, end, f->elem, dst + n * f->size);
+		if (!p)
+			return NULL;
+		n++;
+
+		p = bind_blank(p, end);
+		if ((p < end) && (*p == ']'))
+			goto done;
+		if ((p >= end) || (*p != ',')) {
+			json_error_set(JSON_ERR_SYNTAX, "']' is missing", p);
+			return NULL;
+		}
+		p = bind_blank(p + 1, end);
+	}
+
+	json_error_set(JSON_ERR_SYNTAX, "']' is missing", end);
+	return NULL;
+
+done:
+	memcpy(base + f->count, &n, sizeof(n));
+	return p + 1;
+}
+
+static char *bind_value(char *p, char *end, const struct json_bind_field *f,
+	char *base)
+{
+	if (p >= end) {
+		json_error_set(JSON_ERR_SYNTAX, "value is missing", end);
+		return NULL;
+	}
+
+	switch (f->type) {
+	case JSON_BIND_OBJECT:
+		if (*p != '{')
+			break;
+		return bind_object(p, end, f->fields, base + f->offset);
+	case JSON_BIND_ARRAY:
+		if (*p != '[')
+			break;
+		return bind_array(p, end, f, base);
+	default:
+		return bind_scalar(p, end, f, base + f->offset);
+	}
+
+	json_error_set(JSON_ERR_TYPE, (f->type == JSON_BIND_OBJECT) ?
+		"value is not an object" : "value is not an array", p);
+	return NULL;
+}
+
+int json_bind_from_mem(const char *buf, size_t len,
+	const struct json_bind_field *fields, void *out)
+{
+	char *p = (char *)buf;
+	char *end = p + len;
+	struct json_error_input in;
+	int ret;
+
+	if (!buf || !fields || !out) {
+		json_error_set(JSON_ERR_ARG,
+			"buffer, fields or output is not specified", NULL);
+		return -1;
+	}
+
+	/* the text is only read, the casts follow the scanner prototypes */
+	json_error_enter(&in, buf, end);
+	p = bind_blank(p, end);
+	if ((p >= end) || (*p != '{')) {
+		json_error_set(JSON_ERR_TYPE, "json data is not object", p);
+		ret = -1;
+	} else {
+		ret = bind_object(p, end, fields, (char *)out) ? 0 : -1;
+	}
+	json_error_leave(&in);
+
+	return ret;
+}
+
+int json_bind_from_string(const char *str,
+	const struct json_bind_field *fields, void *out)
+{
+	if (!str) {
+		json_error_set(JSON_ERR_ARG, "string is not specified", NULL);
+		return -1;
+	}
+
+	return json_bind_from_mem(str, strlen(str), fields, out);
+}
+
+int json_bind_from_file(const char *file,
+	const struct json_bind_field *fields, void *out)
+{
+	int fd;
+	size_t len;
+	void *p;
+	int ret = -1;
+
+	if (!file) {
+		json_error_set(JSON_ERR_ARG, "file is not specified", NULL);
+		return -1;
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		json_error_sys(JSON_ERR_IO, "open error");
+		return -1;
+	}
+
+	len = lseek(fd, 0, SEEK_END);
+	if (!len) {
+		json_error_set(JSON_ERR_ARG, "file is empty", NULL);
+		goto end;
+	}
+
+	p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		json_error_sys(JSON_ERR_IO, "mmap error");
+		goto end;
+	}
+	ret = json_bind_from_mem((const char *)p, len, fields, out);
+	munmap(p, len);
+
+end:
+	close(fd);
+	return ret;
+}
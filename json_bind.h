@@ -0,0 +1,65 @@
+#ifndef __JSON_BIND_H__
+#define __JSON_BIND_H__
+
+#include <stddef.h>
+
+#include "json.h"
+
+/*
+ * Decoding straight into C structs. A table of json_bind_field describes
+ * the members of an object: where each one goes in the struct and how it
+ * is converted. json_bind_from_mem() walks the text once and fills the
+ * struct without building json_data nodes. Members missing from the input
+ * are left alone, members missing from the table are skipped.
+ */
+enum json_bind_type {
+	JSON_BIND_INT = 0,	/* signed integer of 1, 2, 4 or 8 bytes */
+	JSON_BIND_UINT,		/* unsigned integer of 1, 2, 4 or 8 bytes */
+	JSON_BIND_DOUBLE,
+	JSON_BIND_STRING,	/* char array, NUL terminated */
+	JSON_BIND_OBJECT,	/* nested struct described by 'fields' */
+	JSON_BIND_ARRAY,	/* C array of 'max' elements described by 'elem' */
+};
+
+struct json_bind_field {
+	const char *name;	/* NULL ends a table */
+	enum json_bind_type type;
+	size_t offset;
+	size_t size;		/* of the member, or of one array element */
+	const struct json_bind_field *fields;
+	const struct json_bind_field *elem;	/* its name and offset are unused */
+	size_t max;
+	size_t count;		/* offset of the size_t element count of arrays */
+};
+
+#define JSON_BIND_MEMBER_SIZE(s, m)	sizeof(((s *)0)->m)
+
+/* members named 'n' in the document, when it is not a C identifier */
+#define JSON_BIND_SCALAR_AS(s, m, n, t) \
+	{ n, t, offsetof(s, m), JSON_BIND_MEMBER_SIZE(s, m), NULL, NULL, 0, 0 }
+#define JSON_BIND_STRUCT_AS(s, m, n, f) \
+	{ n, JSON_BIND_OBJECT, offsetof(s, m), JSON_BIND_MEMBER_SIZE(s, m), \
+	  f, NULL, 0, 0 }
+#define JSON_BIND_ARRAY_OF_AS(s, m, n, e, c) \
+	{ n, JSON_BIND_ARRAY, offsetof(s, m), \
+	  JSON_BIND_MEMBER_SIZE(s, m[0]), NULL, e, \
+	  sizeof(((s *)0)->m) / JSON_BIND_MEMBER_SIZE(s, m[0]), offsetof(s, c) }
+
+#define JSON_BIND_SCALAR(s, m, t)	JSON_BIND_SCALAR_AS(s, m, #m, t)
+#define JSON_BIND_STRUCT(s, m, f)	JSON_BIND_STRUCT_AS(s, m, #m, f)
+#define JSON_BIND_ARRAY_OF(s, m, e, c)	JSON_BIND_ARRAY_OF_AS(s, m, #m, e, c)
+/* element descriptors, for JSON_BIND_ARRAY_OF() */
+#define JSON_BIND_ELEM(t, type) \
+	{ NULL, t, 0, sizeof(type), NULL, NULL, 0, 0 }
+#define JSON_BIND_ELEM_STRUCT(type, f) \
+	{ NULL, JSON_BIND_OBJECT, 0, sizeof(type), f, NULL, 0, 0 }
+#define JSON_BIND_END	{ NULL, JSON_BIND_INT, 0, 0, NULL, NULL, 0, 0 }
+
+int json_bind_from_mem(const char *buf, size_t len,
+	const struct json_bind_field *fields, void *out);
+int json_bind_from_string(const char *str,
+	const struct json_bind_field *fields, void *out);
+int json_bind_from_file(const char *file,
+	const struct json_bind_field *fields, void *out);
+
+#endif /* __JSON_BIND_H__ */
@@ -0,0 +1,330 @@
+#include "json_cursor.h"
+#include "json_int.h"
+#include "json_scan.h"
+
+/* the position is only resolved on failure, calls that succeed stay cheap */
+static int cursor_error(struct json_cursor *c, enum json_error_code code,
+	const char *msg, const char *at)
+{
+	struct json_error_input in;
+
+	json_error_enter(&in, c->begin, c->end);
+	json_error_set(code, msg, at);
+	json_error_leave(&in);
+	c->error = 1;
+
+	return -1;
+}
+
+static void cursor_blank(struct json_cursor *c)
+{
+	c->p = json_scan_skip(c->p, c->end, JSON_SCAN_BLANK);
+}
+
+static int cursor_in_array(struct json_cursor *c)
+{
+	return (c->arrays >> (c->depth - 1)) & 1;
+}
+
+/* the cursor must be at a value */
+static int cursor_at_value(struct json_cursor *c)
+{
+	if (c->error)
+		return -1;
+	if (!c->pending)
+		return cursor_error(c, JSON_ERR_ARG, "cursor is not at a value",
+			c->p);
+	if (c->p >= c->end)
+		return cursor_error(c, JSON_ERR_SYNTAX, "value is missing",
+			c->end);
+
+	return 0;
+}
+
+/* finds the end of the value at the cursor and moves past it */
+static int cursor_value(struct json_cursor *c, json_data *d)
+{
+	struct json_error_input in;
+	size_t offset;
+	char *q;
+
+	if (cursor_at_value(c))
+		return -1;
+
+	/* the text is only read, the casts follow the scanner prototypes */
+	memset(d, 0, sizeof(*d));
+	json_error_enter(&in, c->begin, c->end);
+	q = json_value_end((char *)c->p, (char *)c->end, &offset,
+		&d->value.len, &d->type);
+	json_error_leave(&in);
+	if (!q) {
+		c->error = 1;
+		return -1;
+	}
+	if (d->value.len == 0)
+		return cursor_error(c, JSON_ERR_SYNTAX, "value is missing", c->p);
+
+	d->value.p = (char *)c->p + offset;
+	c->p = q + 1;
+	c->pending = 0;
+
+	return 0;
+}
+
+static int cursor_push(struct json_cursor *c, int array)
+{
+	if (c->depth == JSON_CURSOR_MAX_DEPTH)
+		return cursor_error(c, JSON_ERR_LIMIT, "too deeply nested", c->p);
+
+	if (array)
+		c->arrays |= (uint64_t)1 << c->depth;
+	else
+		c->arrays &= ~((uint64_t)1 << c->depth);
+	c->depth++;
+	c->p++;
+	c->pending = 0;
+	c->first = 1;
+
+	return 0;
+}
+
+/* moves to the next member, past the ',' between members */
+static int cursor_next(struct json_cursor *c, int array)
+{
+	json_data d;
+
+	if (c->error)
+		return -1;
+	if (!c->depth || (cursor_in_array(c) != array))
+		return cursor_error(c, JSON_ERR_ARG, array ?
+			"cursor is not in an array" : "cursor is not in an object",
+			c->p);
+
+	if (c->pending && cursor_value(c, &d))
+		return -1;
+
+	cursor_blank(c);
+	if (c->p >= c->end)
+		return cursor_error(c, JSON_ERR_SYNTAX, array ?
+			"']' is missing" : "'}' is missing", c->end);
+	if (*c->p == (array ? ']' : '}')) {
+		/* the container was a member of its parent, or the root */
+		c->p++;
+		c->depth--;
+		c->first = 0;
+		return 0;
+	}
+
+	if (!c->first) {
+		if (*c->p != ',')
+			return cursor_error(c, JSON_ERR_SYNTAX, "',' is missing",
+				c->p);
+		c->p++;
+		cursor_blank(c);
+	}
+	c->first = 0;
+
+	return 1;
+}
+
+void json_cursor_init(struct json_cursor *c, const char *buf, size_t len)
+{
+	memset(c, 0, sizeof(*c));
+	c->begin = buf;
+	c->end = buf ? buf + len : buf;
+	c->p = buf;
+	c->pending = 1;
+	cursor_blank(c);
+}
+
+int json_cursor_type(struct json_cursor *c)
+{
+	if (!c || c->error || !c->pending || (c->p >= c->end))
+		return -1;
+
+	switch (*c->p) {
+	case '{':
+		return OBJECT;
+	case '[':
+		return ARRAY;
+	case '\"':
+		return STRING;
+	default:
+		return MISC;
+	}
+}
+
+int json_cursor_enter_object(struct json_cursor *c)
+{
+	if (!c || cursor_at_value(c))
+		return -1;
+	if (*c->p != '{')
+		return cursor_error(c, JSON_ERR_TYPE, "value is not an object",
+			c->p);
+
+	return cursor_push(c, 0);
+}
+
+int json_cursor_next_field(struct json_cursor *c, buf_t *name)
+{
+	const char *q;
+	int ret;
+
+	if (!c)
+		return -1;
+
+	ret = cursor_next(c, 0);
+	if (ret <= 0)
+		return ret;
+
+	if (*c->p != '\"')
+		return cursor_error(c, JSON_ERR_SYNTAX, "'name' is missing", c->p);
+	q = json_string_end((char *)c->p, (char *)c->end);
+	if (!q)
+		return cursor_error(c, JSON_ERR_SYNTAX, "'\"' is missing", c->end);
+	if (name) {
+		name->p = (char *)c->p;
+		name->len = q - c->p + 1;
+	}
+
+	c->p = q + 1;
+	cursor_blank(c);
+	if ((c->p >= c->end) || (*c->p != ':'))
+		return cursor_error(c, JSON_ERR_SYNTAX, "':' is missing", c->p);
+	c->p++;
+	cursor_blank(c);
+	c->pending = 1;
+
+	return 1;
+}
+
+int json_cursor_find_field(struct json_cursor *c, const char *name)
+{
+	size_t len;
+	buf_t n;
+	int ret;
+
+	if (!c || !name)
+		return -1;
+
+	len = strlen(name);
+	while ((ret = json_cursor_next_field(c, &n)) > 0) {
+		if ((n.len == len + 2) && !memcmp(n.p + 1, name, len))
+			return 1;
+	}
+
+	return ret;
+}
+
+int json_cursor_enter_array(struct json_cursor *c)
+{
+	if (!c || cursor_at_value(c))
+		return -1;
+	if (*c->p != '[')
+		return cursor_error(c, JSON_ERR_TYPE, "value is not an array",
+			c->p);
+
+	return cursor_push(c, 1);
+}
+
+int json_cursor_next_element(struct json_cursor *c)
+{
+	int ret;
+
+	if (!c)
+		return -1;
+
+	ret = cursor_next(c, 1);
+	if (ret > 0)
+		c->pending = 1;
+
+	return ret;
+}
+
+int json_cursor_leave(struct json_cursor *c)
+{
+	int ret;
+
+	if (!c || c->error)
+		return -1;
+	if (!c->depth)
+		return cursor_error(c, JSON_ERR_ARG,
+			"cursor is not in a container", c->p);
+
+	/* members are skipped whole, so the first end seen is this one */
+	if (cursor_in_array(c)) {
+		while ((ret = json_cursor_next_element(c)) > 0)
+			;
+	} else {
+		while ((ret = json_cursor_next_field(c, NULL)) > 0)
+			;
+	}
+
+	return ret;
+}
+
+int json_cursor_skip(struct json_cursor *c)
+{
+	json_data d;
+
+	if (!c)
+		return -1;
+
+	return cursor_value(c, &d);
+}
+
+int json_cursor_get_raw(struct json_cursor *c, buf_t *value,
+	enum json_type *type)
+{
+	json_data d;
+
+	if (!c || cursor_value(c, &d))
+		return -1;
+
+	if (value)
+		*value = d.value;
+	if (type)
+		*type = d.type;
+
+	return 0;
+}
+
+int json_cursor_get_int64(struct json_cursor *c, int64_t *val)
+{
+	json_data d;
+
+	if (!c || cursor_value(c, &d))
+		return -1;
+
+	return json_data_to_int64(&d, val);
+}
+
+int json_cursor_get_uint64(struct json_cursor *c, uint64_t *val)
+{
+	json_data d;
+
+	if (!c || cursor_value(c, &d))
+		return -1;
+
+	return json_data_to_uint64(&d, val);
+}
+
+int json_cursor_get_double(struct json_cursor *c, double *val)
+{
+	json_data d;
+
+	if (!c || cursor_value(c, &d))
+		return -1;
+
+	return json_data_to_double(&d, val);
+}
+
+int json_cursor_get_string(struct json_cursor *c, char *str, size_t size)
+{
+	json_data d;
+
+	if (!c || cursor_value(c, &d))
+		return -1;
+
+	return json_data_to_string(&d, str, size);
+}
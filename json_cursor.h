@@ -0,0 +1,70 @@
+#ifndef __JSON_CURSOR_H__
+#define __JSON_CURSOR_H__
+
+#include "json.h"
+
+/*
+ * Forward-only reader walking the text in place. Nothing is allocated and
+ * no json_data node is built, values that are not read are skipped. The
+ * cursor is always either at a value, after json_cursor_init() or after a
+ * call moved to a member, or between two members of a container. Reading
+ * or skipping a value, or entering it, moves past it.
+ *
+ *	json_cursor_init(&c, buf, len);
+ *	json_cursor_enter_object(&c);
+ *	if (json_cursor_find_field(&c, "id") > 0)
+ *		json_cursor_get_uint64(&c, &id);
+ *
+ * Once a call fails on the text, every later call fails as well.
+ */
+#define JSON_CURSOR_MAX_DEPTH	64
+
+struct json_cursor {
+	const char *begin;
+	const char *end;
+	const char *p;
+	unsigned int depth;	/* of the containers entered */
+	uint64_t arrays;	/* bit n set when level n is an array */
+	int pending;		/* a value at 'p' has not been read */
+	int first;		/* no member read yet at this level */
+	int error;
+};
+
+void json_cursor_init(struct json_cursor *c, const char *buf, size_t len);
+/* type of the value at the cursor, -1 when it is not at a value */
+int json_cursor_type(struct json_cursor *c);
+
+/*
+ * Moving through containers returns 1 at a member, 0 when the container
+ * is over, the cursor is then past its closing bracket, and -1 on error.
+ * A member that was not read is skipped first.
+ */
+int json_cursor_enter_object(struct json_cursor *c);
+/* 'name' is the raw text of the name with its quotes, it may be NULL */
+int json_cursor_next_field(struct json_cursor *c, buf_t *name);
+/*
+ * looks for 'name' in the members left, so members are best looked for
+ * in document order. When it is missing the object is over. Names with
+ * escapes are compared undecoded.
+ */
+int json_cursor_find_field(struct json_cursor *c, const char *name);
+int json_cursor_enter_array(struct json_cursor *c);
+int json_cursor_next_element(struct json_cursor *c);
+/* skips the rest of the innermost container entered */
+int json_cursor_leave(struct json_cursor *c);
+
+/*
+ * Reading the value at the cursor moves past it, even when it cannot be
+ * converted. 'value' of json_cursor_get_raw() is the text of the value,
+ * strings keep their quotes.
+ */
+int json_cursor_skip(struct json_cursor *c);
+int json_cursor_get_raw(struct json_cursor *c, buf_t *value,
+	enum json_type *type);
+int json_cursor_get_int64(struct json_cursor *c, int64_t *val);
+int json_cursor_get_uint64(struct json_cursor *c, uint64_t *val);
+int json_cursor_get_double(struct json_cursor *c, double *val);
+/* decodes the escapes, the copy is NUL terminated */
+int json_cursor_get_string(struct json_cursor *c, char *str, size_t size);
+
+#endif /* __JSON_CURSOR_H__ */
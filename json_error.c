@@ -0,0 +1,66 @@
+#include <errno.h>
+
+#include "json_int.h"
+
+static __thread struct json_error error = { JSON_OK, "no error", 0, 0, 0,
+	0, 0 };
+static __thread const char *input_begin;
+static __thread const char *input_end;
+
+void json_error_enter(struct json_error_input *saved, const char *begin,
+	const char *end)
+{
+	saved->begin = input_begin;
+	saved->end = input_end;
+	input_begin = begin;
+	input_end = end;
+}
+
+void json_error_leave(struct json_error_input *saved)
+{
+	input_begin = saved->begin;
+	input_end = saved->end;
+}
+
+void json_error_set(enum json_error_code code, const char *msg,
+	const char *at)
+{
+	const char *p, *nl;
+
+	error.code = code;
+	error.msg = msg;
+	error.sys = 0;
+	error.has_pos = 0;
+	error.offset = 0;
+	error.line = 0;
+	error.column = 0;
+
+	if (!at || !input_begin || (at < input_begin) || (at > input_end))
+		return;
+
+	/* only failing calls get here, counting lines is affordable */
+	error.has_pos = 1;
+	error.offset = at - input_begin;
+	error.line = 1;
+	for (p = input_begin; (nl = memchr(p, '\n', at - p)) != NULL; p = nl + 1)
+		error.line++;
+	error.column = at - p + 1;
+}
+
+void json_error_sys(enum json_error_code code, const char *msg)
+{
+	int sys = errno;
+
+	json_error_set(code, msg, NULL);
+	error.sys = sys;
+}
+
+const struct json_error *json_last_error(void)
+{
+	return &error;
+}
+
+void json_clear_error(void)
+{
+	json_error_set(JSON_OK, "no error", NULL);
+}
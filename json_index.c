@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "json_int.h"
+#include "json_scan.h"
+
+/*
+ * Structural index of a large buffer, built on a thread pool. The buffer
+ * is cut into one chunk per thread, never right after a backslash, so no
+ * escape spans two chunks. A first pass counts the quotes of every chunk,
+ * which tells whether each chunk starts inside a string, and a second pass
+ * records the offsets of the structural characters outside strings and of
+ * both quotes of every string.
+ */
+struct index_chunk {
+	pthread_t tid;
+	const char *buf;
+	size_t begin;
+	size_t end;
+	size_t quotes;		/* unescaped '"' in the chunk */
+	int in_string;		/* at 'begin' */
+	size_t *pos;
+	size_t npos;
+	size_t size;
+	int ret;
+	int sys;		/* errno of a failed 'ret', set by the caller */
+};
+
+/* chunks below this size are not worth a thread */
+#ifndef INDEX_MIN_CHUNK
+#define INDEX_MIN_CHUNK		(1 << 20)
+#endif
+
+/*
+ * class bits of the 64 bytes at 'p', the tail of the chunk is copied into
+ * a zeroed block first since the mask reads whole blocks
+ */
+static uint64_t index_mask(const char *p, const char *end,
+	unsigned int classes)
+{
+	char tail[JSON_SCAN_BLOCK];
+
+	if (end - p >= JSON_SCAN_BLOCK)
+		return json_scan_mask(p, classes);
+
+	memset(tail, 0, sizeof(tail));
+	memcpy(tail, p, end - p);
+	return json_scan_mask(tail, classes);
+}
+
+static void *index_count(void *data)
+{
+	struct index_chunk *c = (struct index_chunk *)data;
+	const char *p = c->buf + c->begin;
+	const char *end = c->buf + c->end;
+	uint64_t bits;
+	int escaped = 0;	/* the first byte of the block */
+	int i;
+
+	for (; p < end; p += JSON_SCAN_BLOCK) {
+		bits = index_mask(p, end, JSON_SCAN_QUOTE | JSON_SCAN_BACKSLASH);
+		if (escaped)
+			bits &= ~(uint64_t)1;
+		escaped = 0;
+		while (bits) {
+			i = __builtin_ctzll(bits);
+			if (p[i] == '\"') {
+				c->quotes++;
+			} else if (i == JSON_SCAN_BLOCK - 1) {
+				escaped = 1;
+			} else {
+				bits &= ~((uint64_t)2 << i);
+			}
+			bits &= bits - 1;
+		}
+	}
+
+	return NULL;
+}
+
+static int index_push(struct index_chunk *c, size_t pos)
+{
+	size_t *n;
+	size_t size;
+
+	if (c->npos == c->size) {
+		size = c->size ? c->size * 2 : 1024;
+		n = (size_t *)realloc(c->pos, size * sizeof(*n));
+		if (!n) {
+			/* the error slot of a worker is not the caller's */
+			c->sys = errno;
+			return -1;
+		}
+		c->pos = n;
+		c->size = size;
+	}
+	c->pos[c->npos++] = pos;
+
+	return 0;
+}
+
+/* stray backslashes outside strings pair up as in index_count() */
+static void *index_scan(void *data)
+{
+	struct index_chunk *c = (struct index_chunk *)data;
+	const char *p = c->buf + c->begin;
+	const char *end = c->buf + c->end;
+	size_t base = c->begin;
+	int in_string = c->in_string;
+	uint64_t bits;
+	int escaped = 0;
+	int i;
+
+	for (; p < end; p += JSON_SCAN_BLOCK, base += JSON_SCAN_BLOCK) {
+		bits = index_mask(p, end, JSON_SCAN_STRUCTURAL |
+			JSON_SCAN_QUOTE | JSON_SCAN_BACKSLASH);
+		if (escaped)
+			bits &= ~(uint64_t)1;
+		escaped = 0;
+		while (bits) {
+			i = __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if (p[i] == '\\') {
+				if (i == JSON_SCAN_BLOCK - 1)
+					escaped = 1;
+				else
+					bits &= ~((uint64_t)2 << i);
+				continue;
+			}
+			if (p[i] == '\"')
+				in_string = !in_string;
+			else if (in_string)
+				continue;
+			if (index_push(c, base + i)) {
+				c->ret = -1;
+				return NULL;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void index_run(struct index_chunk *chunks, int n,
+	void *(*fn)(void *))
+{
+	int i, started;
+
+	/* the first chunk runs on the calling thread */
+	for (started = 1; started < n; started++) {
+		if (pthread_create(&chunks[started].tid, NULL, fn,
+			&chunks[started])) {
+			break;
+		}
+	}
+	fn(&chunks[0]);
+	for (i = 1; i < started; i++)
+		pthread_join(chunks[i].tid, NULL);
+
+	/* chunks without a thread are done here */
+	for (i = started; i < n; i++)
+		fn(&chunks[i]);
+}
+
+int json_index_chunks(size_t len, int nthreads)
+{
+	size_t n = len / INDEX_MIN_CHUNK;
+
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > (size_t)nthreads)
+		n = nthreads;
+
+	return n ? n : 1;
+}
+
+size_t *json_index_build(const char *buf, size_t len, int nthreads,
+	size_t *npos)
+{
+	struct index_chunk *chunks;
+	size_t *pos = NULL;
+	size_t total = 0;
+	size_t step, b;
+	int in_string = 0;
+	int i, n;
+
+	n = json_index_chunks(len, nthreads);
+	chunks = (struct index_chunk *)calloc(n, sizeof(*chunks));
+	if (!chunks) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc chunks error");
+		return NULL;
+	}
+
+	step = len / n;
+	for (i = 0, b = 0; i < n; i++) {
+		chunks[i].buf = buf;
+		chunks[i].begin = b;
+		b = (i == n - 1) ? len : (i + 1) * step;
+		if (b < chunks[i].begin)
+			b = chunks[i].begin;
+		while ((b < len) && (b > 0) && (buf[b - 1] == '\\'))
+			b++;
+		chunks[i].end = b;
+	}
+
+	index_run(chunks, n, index_count);
+	for (i = 0; i < n; i++) {
+		chunks[i].in_string = in_string;
+		in_string ^= chunks[i].quotes & 1;
+	}
+
+	index_run(chunks, n, index_scan);
+	for (i = 0; i < n; i++) {
+		if (chunks[i].ret) {
+			errno = chunks[i].sys;
+			json_error_sys(JSON_ERR_NOMEM, "realloc index error");
+			goto end;
+		}
+		total += chunks[i].npos;
+	}
+
+	pos = (size_t *)malloc((total + 1) * sizeof(*pos));
+	if (!pos) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc index error");
+		goto end;
+	}
+	for (i = 0, total = 0; i < n; i++) {
+		if (chunks[i].npos)
+			memcpy(pos + total, chunks[i].pos,
+				chunks[i].npos * sizeof(*pos));
+		total += chunks[i].npos;
+	}
+	/* a sentinel past the end, so readers never run off the index */
+	pos[total] = len;
+	*npos = total;
+
+end:
+	for (i = 0; i < n; i++)
+		free(chunks[i].pos);
+	free(chunks);
+
+	return pos;
+}
@@ -0,0 +1,96 @@
+#ifndef __JSON_INT_H__
+#define __JSON_INT_H__
+
+#include "json.h"
+
+/*
+ * Scanners of json.c shared with the other modules of the library, not
+ * part of the API. Both return the last byte of the value, or NULL.
+ */
+
+/* 'begin' may start with blanks, they are counted in 'offset' */
+char *json_value_end(char *begin, char *end, size_t *offset, size_t *len,
+	enum json_type *type);
+/* 'begin' points to the opening '"' */
+char *json_string_end(char *begin, char *end);
+/* start of the input of the document 'd' belongs to */
+const char *json_data_doc_text(json_data *d);
+
+/*
+ * "C" locale made on first use and kept for the life of the process,
+ * numbers are read and written with it whatever LC_NUMERIC is. NULL when
+ * it cannot be made.
+ */
+#include <locale.h>
+
+locale_t json_c_locale(void);
+
+/*
+ * Error slot of json_last_error(). Positions are given as pointers and
+ * turned into offsets against the input set by json_error_enter(), NULL
+ * when the error has no position. Entry points bracket their parse with
+ * enter/leave so that nested parses restore the outer input.
+ */
+struct json_error_input {
+	const char *begin;
+	const char *end;
+};
+
+void json_error_set(enum json_error_code code, const char *msg,
+	const char *at);
+/* also keeps errno */
+void json_error_sys(enum json_error_code code, const char *msg);
+void json_error_enter(struct json_error_input *saved, const char *begin,
+	const char *end);
+void json_error_leave(struct json_error_input *saved);
+
+/*
+ * Steps wanted by a projection parse, as a tree: the steps below one step
+ * are chained from 'child' through 'next'. A step is looked up by 'name'
+ * in objects and by 'idx' in arrays, a step without children keeps its
+ * whole value. Built by json_path_parse() from compiled paths.
+ */
+struct json_proj {
+	const char *name;	/* NULL for a bracketed index */
+	size_t len;
+	long idx;		/* -1 when the step is not a number */
+	int whole;		/* a path ends here, 'child' is NULL */
+	struct json_proj *child;
+	struct json_proj *next;
+};
+
+/* 'proj' lists the steps below the root, NULL keeps the whole document */
+json_data *json_data_from_mem_proj(const char *buf, size_t len,
+	unsigned int flags, const struct json_proj *proj);
+
+/*
+ * offsets of the structural characters outside strings and of both quotes
+ * of every string, followed by 'len' as a sentinel, see json_index.c
+ */
+size_t *json_index_build(const char *buf, size_t len, int nthreads,
+	size_t *npos);
+/* number of chunks, and threads, json_index_build() uses for 'len' */
+int json_index_chunks(size_t len, int nthreads);
+
+/*
+ * Counting hooks of json_stats.h. Each thread only adds to its own
+ * counters, atomically so that json_stats_get() and json_stats_reset()
+ * from other threads neither race with it nor lose a reset.
+ */
+#ifdef JSON_STATS
+#include "json_stats.h"
+
+struct json_stats *json_stats_local(void);
+
+#define JSON_STAT_ADD(field, n) do { \
+	struct json_stats *s_ = json_stats_local(); \
+	if (s_) \
+		__atomic_fetch_add(&s_->field, (n), __ATOMIC_RELAXED); \
+} while (0)
+#else
+#define JSON_STAT_ADD(field, n)	do { } while (0)
+#endif
+
+#define JSON_STAT_INC(field)	JSON_STAT_ADD(field, 1)
+
+#endif /* __JSON_INT_H__ */
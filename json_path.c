@@ -0,0 +1,290 @@
+#include "json_path.h"
+#include "json_int.h"
+
+struct path_step {
+	char *name;	/* NULL for a bracketed index */
+	long idx;	/* index into an array, -1 when the step is not a number */
+};
+
+struct json_path {
+	struct path_step *steps;
+	size_t nsteps;
+	char *names;	/* storage of every step name */
+	/* result of the last resolution */
+	json_data *root;
+	uint64_t doc_id;
+	json_data *node;
+};
+
+static int is_digit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+/* index of a step made only of digits, -1 otherwise */
+static long path_index(const char *p, size_t len)
+{
+	long idx = 0;
+	size_t i;
+
+	if ((len == 0) || ((len > 1) && (p[0] == '0')))
+		return -1;
+
+	for (i = 0; i < len; i++) {
+		if (!is_digit(p[i]) || (idx > (0x7fffffffL - 9) / 10))
+			return -1;
+		idx = idx * 10 + (p[i] - '0');
+	}
+
+	return idx;
+}
+
+/* flow_match[1].ip_ttl_en */
+static int path_parse_dotted(struct json_path *path, const char *p)
+{
+	struct path_step *s;
+	char *n = path->names;
+	const char *begin;
+
+	while (*p) {
+		s = &path->steps[path->nsteps];
+		if (*p == '[') {
+			begin = ++p;
+			while (is_digit(*p))
+				p++;
+			if (*p != ']') {
+				json_error_set(JSON_ERR_SYNTAX,
+					"']' is missing in path", p);
+				return -1;
+			}
+			s->name = NULL;
+			s->idx = path_index(begin, p - begin);
+			if (s->idx < 0) {
+				json_error_set(JSON_ERR_RANGE, "bad index in path",
+					begin);
+				return -1;
+			}
+			p++;
+		} else {
+			if ((*p == '.') && path->nsteps)
+				p++;
+			begin = p;
+			while (*p && (*p != '.') && (*p != '['))
+				p++;
+			if (p == begin) {
+				json_error_set(JSON_ERR_SYNTAX,
+					"name is empty in path", p);
+				return -1;
+			}
+			s->name = n;
+			s->idx = -1;
+			memcpy(n, begin, p - begin);
+			n += p - begin;
+			*n++ = '\0';
+		}
+		path->nsteps++;
+	}
+
+	return 0;
+}
+
+/* /flow_match/1/ip_ttl_en, "~1" stands for '/' and "~0" for '~' */
+static int path_parse_pointer(struct json_path *path, const char *p)
+{
+	struct path_step *s;
+	char *n = path->names;
+
+	while (*p == '/') {
+		s = &path->steps[path->nsteps++];
+		s->name = n;
+		for (p++; *p && (*p != '/'); p++) {
+			if (*p == '~') {
+				if ((p[1] != '0') && (p[1] != '1')) {
+					json_error_set(JSON_ERR_ESCAPE,
+						"bad escape in path", p);
+					return -1;
+				}
+				*n++ = (*++p == '0') ? '~' : '/';
+			} else {
+				*n++ = *p;
+			}
+		}
+		*n++ = '\0';
+		s->idx = path_index(s->name, n - s->name - 1);
+	}
+
+	return 0;
+}
+
+struct json_path *json_path_compile(const char *expr)
+{
+	struct json_path *path;
+	struct json_error_input in;
+	size_t len;
+	int ret;
+
+	if (!expr) {
+		json_error_set(JSON_ERR_ARG, "path is not specified", NULL);
+		return NULL;
+	}
+
+	len = strlen(expr);
+	path = (struct json_path *)calloc(1, sizeof(*path));
+	if (!path) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc path error");
+		return NULL;
+	}
+
+	/* never more steps than bytes, nor more name bytes than 2 per byte */
+	path->steps = (struct path_step *)malloc((len + 1) * sizeof(*path->steps));
+	path->names = (char *)malloc(2 * len + 1);
+	if (!path->steps || !path->names) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc path error");
+		json_path_free(path);
+		return NULL;
+	}
+
+	/* positions of syntax errors are columns of the expression */
+	json_error_enter(&in, expr, expr + len);
+	if ((*expr == '/') || (*expr == '\0'))
+		ret = path_parse_pointer(path, expr);
+	else
+		ret = path_parse_dotted(path, expr);
+	json_error_leave(&in);
+	if (ret) {
+		json_path_free(path);
+		return NULL;
+	}
+
+	return path;
+}
+
+json_data *json_path_get(struct json_path *path, json_data *root)
+{
+	struct path_step *s;
+	json_data *d = root;
+	uint64_t id;
+	size_t i;
+
+	if (!path || !root)
+		return NULL;
+
+	/* document ids are never reused, so a hit cannot be a stale pointer */
+	id = json_data_doc_id(root);
+	if ((path->root == root) && (path->doc_id == id))
+		return path->node;
+
+	for (i = 0; d && (i < path->nsteps); i++) {
+		s = &path->steps[i];
+		if ((d->type == ARRAY) && (s->idx >= 0))
+			d = json_data_get_by_index(d, (int)s->idx);
+		else if ((d->type == OBJECT) && s->name)
+			d = json_data_get_by_name(d, s->name);
+		else
+			d = NULL;
+	}
+
+	path->root = root;
+	path->doc_id = id;
+	path->node = d;
+
+	return d;
+}
+
+void json_path_free(struct json_path *path)
+{
+	if (path) {
+		if (path->steps)
+			free(path->steps);
+		if (path->names)
+			free(path->names);
+		free(path);
+	}
+}
+
+/* adds the steps of 'path' below 'list', 'nodes' has room for them */
+static void path_proj_add(struct json_proj **list, struct json_path *path,
+	struct json_proj **nodes)
+{
+	struct path_step *s;
+	struct json_proj *p = NULL;
+	size_t i;
+
+	for (i = 0; i < path->nsteps; i++) {
+		s = &path->steps[i];
+		for (p = *list; p; p = p->next) {
+			if ((p->idx == s->idx) && (!p->name == !s->name) &&
+				(!s->name || !strcmp(p->name, s->name)))
+				break;
+		}
+		if (!p) {
+			p = (*nodes)++;
+			p->name = s->name;
+			p->len = s->name ? strlen(s->name) : 0;
+			p->idx = s->idx;
+			p->next = *list;
+			*list = p;
+		} else if (p->whole) {
+			/* a shorter path keeps the whole value already */
+			return;
+		}
+		list = &p->child;
+	}
+
+	if (p) {
+		p->whole = 1;
+		p->child = NULL;
+	}
+}
+
+json_data *json_path_parse(const char *buf, size_t len,
+	const char *const *exprs, size_t n, unsigned int flags)
+{
+	struct json_path **paths;
+	struct json_proj *nodes = NULL, *next;
+	struct json_proj *proj = NULL;
+	json_data *d = NULL;
+	size_t i, nsteps = 0;
+	int whole = 0;
+
+	if (!buf || !exprs || !n) {
+		json_error_set(JSON_ERR_ARG, "buffer or paths are not specified",
+			NULL);
+		return NULL;
+	}
+
+	paths = (struct json_path **)calloc(n, sizeof(*paths));
+	if (!paths) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc path error");
+		return NULL;
+	}
+	for (i = 0; i < n; i++) {
+		paths[i] = json_path_compile(exprs[i]);
+		if (!paths[i])
+			goto end;
+		nsteps += paths[i]->nsteps;
+	}
+
+	nodes = (struct json_proj *)calloc(nsteps + 1, sizeof(*nodes));
+	if (!nodes) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc path error");
+		goto end;
+	}
+	next = nodes;
+	for (i = 0; i < n; i++) {
+		/* an empty path is the whole document */
+		if (!paths[i]->nsteps)
+			whole = 1;
+		path_proj_add(&proj, paths[i], &next);
+	}
+
+	d = json_data_from_mem_proj(buf, len, flags, whole ? NULL : proj);
+
+end:
+	free(nodes);
+	for (i = 0; i < n; i++)
+		json_path_free(paths[i]);
+	free(paths);
+
+	return d;
+}
@@ -0,0 +1,30 @@
+#ifndef __JSON_PATH_H__
+#define __JSON_PATH_H__
+
+#include "json.h"
+
+/*
+ * Paths compiled once and resolved against many documents. Two syntaxes
+ * are accepted:
+ *	flow_match[1].ip_ttl_en		dotted names and bracketed indexes
+ *	/flow_match/1/ip_ttl_en		RFC 6901 JSON pointer
+ * The node found in the last document is cached in the handle, so a
+ * handle must not be used by two threads at the same time.
+ */
+struct json_path;
+
+struct json_path *json_path_compile(const char *expr);
+json_data *json_path_get(struct json_path *path, json_data *root);
+void json_path_free(struct json_path *path);
+
+/*
+ * Parses only what the 'n' expressions reach. Every other subtree is
+ * stepped over by bracket matching and gets no node. The values reached
+ * are parsed as usual, the containers on the way only hold the members
+ * reached, and array elements up to the last index reached, so that
+ * json_path_get() with the same expressions finds them.
+ */
+json_data *json_path_parse(const char *buf, size_t len,
+	const char *const *exprs, size_t n, unsigned int flags);
+
+#endif /* __JSON_PATH_H__ */
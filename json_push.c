@@ -0,0 +1,382 @@
+#include "json_push.h"
+#include "json_int.h"
+#include "json_scan.h"
+
+enum push_state {
+	PS_VALUE = 0,	/* a value is expected */
+	PS_NAME,	/* a member name or '}' is expected */
+	PS_COLON,	/* ':' is expected */
+	PS_AFTER,	/* ',' or the end of the container is expected */
+	PS_STRING,	/* inside a string */
+	PS_MISC,	/* inside a number or a literal */
+	PS_ERROR,
+};
+
+struct json_push {
+	json_push_event_cb ev;
+	json_push_doc_cb doc;
+	void *arg;
+	unsigned int flags;
+	enum push_state state;
+	int is_name;		/* the string in progress is a member name */
+	int escape;		/* the chunk ended right after a '\\' */
+	int empty;		/* nothing seen yet in the innermost container */
+	int in_doc;		/* a top-level value is in progress */
+	char *stack;		/* '{' or '[' of every open container */
+	size_t depth;
+	size_t stack_size;
+	buf_t carry;		/* the part of a split token seen so far */
+	size_t carry_size;
+	buf_t docbuf;		/* the part of the current document seen so far */
+	size_t docbuf_size;
+	/* valid during json_push_feed() only */
+	const char *tok;
+	const char *doc_start;
+};
+
+static int push_append(buf_t *b, size_t *size, const char *p, size_t len)
+{
+	char *n;
+	size_t s;
+
+	if (b->len + len > *size) {
+		s = *size ? *size : 256;
+		while (s < b->len + len)
+			s *= 2;
+		n = (char *)realloc(b->p, s);
+		if (!n) {
+			json_error_sys(JSON_ERR_NOMEM, "realloc push buffer error");
+			return -1;
+		}
+		b->p = n;
+		*size = s;
+	}
+	memcpy(b->p + b->len, p, len);
+	b->len += len;
+
+	return 0;
+}
+
+static int push_emit(struct json_push *p, enum json_push_event ev, buf_t *tok)
+{
+	if (p->ev && p->ev(p->arg, ev, tok))
+		return -1;
+
+	return 0;
+}
+
+/* the token started at p->tok (or in an earlier chunk) ends before 'q' */
+static int push_token(struct json_push *p, enum json_push_event ev,
+	const char *q)
+{
+	buf_t tok;
+	int ret;
+
+	if (p->carry.len) {
+		if (push_append(&p->carry, &p->carry_size, p->tok, q - p->tok))
+			return -1;
+		ret = push_emit(p, ev, &p->carry);
+		p->carry.len = 0;
+		return ret;
+	}
+
+	tok.p = (char *)p->tok;
+	tok.len = q - p->tok;
+
+	return push_emit(p, ev, &tok);
+}
+
+static void push_doc_begin(struct json_push *p, const char *q)
+{
+	if (p->depth == 0) {
+		p->in_doc = 1;
+		p->doc_start = q;
+	}
+}
+
+/* a value ended right before 'q' */
+static int push_value_done(struct json_push *p, const char *q)
+{
+	json_data *d;
+	int ret = 0;
+
+	if (p->depth) {
+		p->state = PS_AFTER;
+		return 0;
+	}
+
+	p->state = PS_VALUE;
+	p->in_doc = 0;
+
+	if (p->doc) {
+		if (p->docbuf.len) {
+			if (push_append(&p->docbuf, &p->docbuf_size, p->doc_start,
+				q - p->doc_start))
+				return -1;
+			d = json_data_from_mem(p->docbuf.p, p->docbuf.len,
+				p->flags);
+			p->docbuf.len = 0;
+		} else {
+			d = json_data_from_mem(p->doc_start, q - p->doc_start,
+				p->flags);
+		}
+		if (!d || p->doc(p->arg, d))
+			ret = -1;
+	}
+
+	if (!ret)
+		ret = push_emit(p, JSON_PUSH_DOC_END, NULL);
+
+	return ret;
+}
+
+static int push_open(struct json_push *p, char c)
+{
+	char *n;
+	size_t size;
+
+	if (p->depth == p->stack_size) {
+		size = p->stack_size ? p->stack_size * 2 : 32;
+		n = (char *)realloc(p->stack, size);
+		if (!n) {
+			json_error_sys(JSON_ERR_NOMEM, "realloc push stack error");
+			return -1;
+		}
+		p->stack = n;
+		p->stack_size = size;
+	}
+	p->stack[p->depth++] = c;
+	p->empty = 1;
+	p->state = (c == '{') ? PS_NAME : PS_VALUE;
+
+	return push_emit(p, (c == '{') ? JSON_PUSH_OBJECT_BEGIN :
+		JSON_PUSH_ARRAY_BEGIN, NULL);
+}
+
+/* 'q' points to the closing bracket */
+static int push_close(struct json_push *p, const char *q)
+{
+	char c = p->stack[--p->depth];
+
+	if (push_emit(p, (c == '{') ? JSON_PUSH_OBJECT_END :
+		JSON_PUSH_ARRAY_END, NULL))
+		return -1;
+
+	return push_value_done(p, q + 1);
+}
+
+/* 's' is in the chunk given to json_push_feed(), offsets count from it */
+static void push_error(struct json_push *p, const char *msg, const char *s)
+{
+	json_error_set(JSON_ERR_SYNTAX, msg, s);
+	p->state = PS_ERROR;
+}
+
+/* bytes outside of tokens */
+static const char *push_struct(struct json_push *p, const char *s)
+{
+	char c = *s;
+	char top = p->depth ? p->stack[p->depth - 1] : 0;
+	int ret = 0;
+
+	switch (p->state) {
+	case PS_VALUE:
+		if ((c == '{') || (c == '[')) {
+			push_doc_begin(p, s);
+			ret = push_open(p, c);
+		} else if ((c == ']') && (top == '[') && p->empty) {
+			ret = push_close(p, s);
+		} else if (c == '\"') {
+			push_doc_begin(p, s);
+			p->tok = s;
+			p->is_name = 0;
+			p->state = PS_STRING;
+		} else if (json_scan_class[(unsigned char)c] &
+			JSON_SCAN_STRUCTURAL) {
+			push_error(p, "unexpected character", s);
+			return NULL;
+		} else {
+			push_doc_begin(p, s);
+			p->tok = s;
+			p->state = PS_MISC;
+		}
+		break;
+	case PS_NAME:
+		if (c == '\"') {
+			p->tok = s;
+			p->is_name = 1;
+			p->state = PS_STRING;
+		} else if ((c == '}') && p->empty) {
+			ret = push_close(p, s);
+		} else {
+			push_error(p, "'name' is missing", s);
+			return NULL;
+		}
+		break;
+	case PS_COLON:
+		if (c != ':') {
+			push_error(p, "':' is missing", s);
+			return NULL;
+		}
+		p->state = PS_VALUE;
+		break;
+	case PS_AFTER:
+		if (c == ',') {
+			p->state = (top == '{') ? PS_NAME : PS_VALUE;
+			p->empty = 0;
+		} else if (((c == '}') && (top == '{')) ||
+			((c == ']') && (top == '['))) {
+			ret = push_close(p, s);
+		} else {
+			push_error(p, "',' is missing", s);
+			return NULL;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return ret ? NULL : s + 1;
+}
+
+struct json_push *json_push_new(json_push_event_cb ev, json_push_doc_cb doc,
+	void *arg, unsigned int flags)
+{
+	struct json_push *p;
+
+	p = (struct json_push *)calloc(1, sizeof(*p));
+	if (!p) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc push error");
+		return NULL;
+	}
+	p->ev = ev;
+	p->doc = doc;
+	p->arg = arg;
+	p->flags = flags;
+	p->state = PS_VALUE;
+
+	return p;
+}
+
+int json_push_feed(struct json_push *p, const char *buf, size_t len)
+{
+	const char *s = buf;
+	const char *end = buf + len;
+	const char *q;
+	struct json_error_input in;
+	int ret = -1;
+
+	if (!p || (!buf && len))
+		return -1;
+
+	if (p->state == PS_ERROR)
+		return -1;
+
+	/* a token or a document carried over continues at the chunk start */
+	p->tok = buf;
+	p->doc_start = buf;
+	json_error_enter(&in, buf, end);
+
+	while (s < end) {
+		switch (p->state) {
+		case PS_STRING:
+			if (p->escape) {
+				p->escape = 0;
+				s++;
+				break;
+			}
+			q = json_scan_find(s, end,
+				JSON_SCAN_QUOTE | JSON_SCAN_BACKSLASH);
+			if (q == end) {
+				s = end;
+			} else if (*q == '\\') {
+				p->escape = 1;
+				s = q + 1;
+			} else {
+				s = q + 1;
+				if (p->is_name) {
+					if (push_token(p, JSON_PUSH_NAME, s))
+						goto err;
+					p->state = PS_COLON;
+				} else if (push_token(p, JSON_PUSH_STRING, s) ||
+					push_value_done(p, s)) {
+					goto err;
+				}
+			}
+			break;
+		case PS_MISC:
+			q = json_scan_find(s, end, JSON_SCAN_CLOSE |
+				JSON_SCAN_COMMA | JSON_SCAN_BLANK);
+			s = q;
+			if ((q != end) && (push_token(p, JSON_PUSH_MISC, q) ||
+				push_value_done(p, q)))
+				goto err;
+			break;
+		default:
+			if (json_scan_class[(unsigned char)*s] & JSON_SCAN_BLANK) {
+				s = json_scan_skip(s, end, JSON_SCAN_BLANK);
+				break;
+			}
+			s = push_struct(p, s);
+			if (!s)
+				goto err;
+			break;
+		}
+	}
+
+	if ((p->state == PS_STRING) || (p->state == PS_MISC)) {
+		if (push_append(&p->carry, &p->carry_size, p->tok, end - p->tok))
+			goto err;
+	}
+	if (p->doc && p->in_doc) {
+		if (push_append(&p->docbuf, &p->docbuf_size, p->doc_start,
+			end - p->doc_start))
+			goto err;
+	}
+	ret = 0;
+
+err:
+	if (ret)
+		p->state = PS_ERROR;
+	json_error_leave(&in);
+	return ret;
+}
+
+/* end of input, completes a trailing number or literal */
+int json_push_finish(struct json_push *p)
+{
+	if (!p || (p->state == PS_ERROR))
+		return -1;
+
+	if (p->state == PS_MISC) {
+		/* the token and the document are both fully carried */
+		p->tok = p->carry.p + p->carry.len;
+		p->doc_start = p->docbuf.p + p->docbuf.len;
+		if (push_token(p, JSON_PUSH_MISC, p->tok) ||
+			push_value_done(p, p->doc_start)) {
+			p->state = PS_ERROR;
+			return -1;
+		}
+	}
+
+	if ((p->state != PS_VALUE) || p->depth) {
+		json_error_set(JSON_ERR_SYNTAX, "input ends inside a value", NULL);
+		p->state = PS_ERROR;
+		return -1;
+	}
+
+	return 0;
+}
+
+void json_push_free(struct json_push *p)
+{
+	if (p) {
+		if (p->stack)
+			free(p->stack);
+		if (p->carry.p)
+			free(p->carry.p);
+		if (p->docbuf.p)
+			free(p->docbuf.p);
+		free(p);
+	}
+}
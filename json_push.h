@@ -0,0 +1,44 @@
+#ifndef __JSON_PUSH_H__
+#define __JSON_PUSH_H__
+
+#include "json.h"
+
+/*
+ * Incremental parser for input that arrives in chunks. Tokens are reported
+ * as soon as they are complete, only a token split across two chunks is
+ * copied. Concatenated top-level values are parsed one after the other.
+ */
+enum json_push_event {
+	JSON_PUSH_OBJECT_BEGIN = 0,
+	JSON_PUSH_OBJECT_END,
+	JSON_PUSH_ARRAY_BEGIN,
+	JSON_PUSH_ARRAY_END,
+	JSON_PUSH_NAME,		/* member name, with its quotes */
+	JSON_PUSH_STRING,	/* string value, with its quotes */
+	JSON_PUSH_MISC,		/* number, true, false, null... */
+	JSON_PUSH_DOC_END,	/* a top-level value is complete */
+};
+
+/*
+ * 'tok' is only valid during the call and is NULL for the events without
+ * a token. A non-zero return stops the parser.
+ */
+typedef int (*json_push_event_cb)(void *arg, enum json_push_event ev,
+	buf_t *tok);
+
+/*
+ * Called with every complete top-level value, the callee owns 'd'. Only
+ * the value in progress is kept, and only when this callback is set.
+ */
+typedef int (*json_push_doc_cb)(void *arg, json_data *d);
+
+struct json_push;
+
+/* 'flags' are the json_parse_flags used for the documents */
+struct json_push *json_push_new(json_push_event_cb ev, json_push_doc_cb doc,
+	void *arg, unsigned int flags);
+int json_push_feed(struct json_push *p, const char *buf, size_t len);
+int json_push_finish(struct json_push *p);
+void json_push_free(struct json_push *p);
+
+#endif /* __JSON_PUSH_H__ */
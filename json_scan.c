@@ -0,0 +1,425 @@
+#include "json_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_SCAN_X86
+#endif
+
+const uint8_t json_scan_class[256] = {
+	['"'] = JSON_SCAN_QUOTE,
+	['\\'] = JSON_SCAN_BACKSLASH,
+	['{'] = JSON_SCAN_OPEN,
+	['['] = JSON_SCAN_OPEN,
+	['}'] = JSON_SCAN_CLOSE,
+	[']'] = JSON_SCAN_CLOSE,
+	[':'] = JSON_SCAN_COLON,
+	[','] = JSON_SCAN_COMMA,
+	[' '] = JSON_SCAN_SPACE,
+	['\t'] = JSON_SCAN_CTRL,
+	['\n'] = JSON_SCAN_CTRL,
+	['\r'] = JSON_SCAN_CTRL,
+};
+
+static uint64_t scan_mask_scalar(const char *p, unsigned int classes)
+{
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i++)
+		if (json_scan_class[(unsigned char)p[i]] & classes)
+			bits |= (uint64_t)1 << i;
+
+	return bits;
+}
+
+#ifdef JSON_SCAN_X86
+/*
+ * The class of a byte is lo[c & 0xf] & hi[c >> 4]. Each class is a set of
+ * (high nibble, low nibble) pairs that is a full cross product, so the AND
+ * of the two lookups never reports a class for a byte outside of it.
+ */
+#define LO_NIBBLES \
+	JSON_SCAN_SPACE, 0, JSON_SCAN_QUOTE, 0, 0, 0, 0, 0, \
+	0, JSON_SCAN_CTRL, JSON_SCAN_CTRL | JSON_SCAN_COLON, JSON_SCAN_OPEN, \
+	JSON_SCAN_BACKSLASH | JSON_SCAN_COMMA, JSON_SCAN_CTRL | JSON_SCAN_CLOSE, \
+	0, 0
+#define HI_NIBBLES \
+	JSON_SCAN_CTRL, 0, JSON_SCAN_SPACE | JSON_SCAN_QUOTE | JSON_SCAN_COMMA, \
+	JSON_SCAN_COLON, 0, \
+	JSON_SCAN_BACKSLASH | JSON_SCAN_OPEN | JSON_SCAN_CLOSE, 0, \
+	JSON_SCAN_OPEN | JSON_SCAN_CLOSE, \
+	0, 0, 0, 0, 0, 0, 0, 0
+
+__attribute__((target("sse4.2")))
+static uint64_t scan_mask_sse42(const char *p, unsigned int classes)
+{
+	const __m128i lo = _mm_setr_epi8(LO_NIBBLES);
+	const __m128i hi = _mm_setr_epi8(HI_NIBBLES);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i want = _mm_set1_epi8((char)classes);
+	const __m128i zero = _mm_setzero_si128();
+	uint64_t bits = 0;
+	__m128i v, c;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(p + i));
+		c = _mm_and_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, nibble)),
+			_mm_shuffle_epi8(hi,
+				_mm_and_si128(_mm_srli_epi16(v, 4), nibble)));
+		c = _mm_cmpeq_epi8(_mm_and_si128(c, want), zero);
+		bits |= (uint64_t)(uint16_t)~_mm_movemask_epi8(c) << i;
+	}
+
+	return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t scan_mask_avx2(const char *p, unsigned int classes)
+{
+	const __m256i lo = _mm256_setr_epi8(LO_NIBBLES, LO_NIBBLES);
+	const __m256i hi = _mm256_setr_epi8(HI_NIBBLES, HI_NIBBLES);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i want = _mm256_set1_epi8((char)classes);
+	const __m256i zero = _mm256_setzero_si256();
+	uint64_t bits = 0;
+	__m256i v, c;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(p + i));
+		c = _mm256_and_si256(
+			_mm256_shuffle_epi8(lo, _mm256_and_si256(v, nibble)),
+			_mm256_shuffle_epi8(hi, _mm256_and_si256(
+				_mm256_srli_epi16(v, 4), nibble)));
+		c = _mm256_cmpeq_epi8(_mm256_and_si256(c, want), zero);
+		bits |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(c) << i;
+	}
+
+	return bits;
+}
+
+/* '"', '\\' and the control characters below 0x20 */
+__attribute__((target("sse4.2")))
+static uint64_t escape_mask_sse42(const char *p)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1f);
+	uint64_t bits = 0;
+	__m128i v, c;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(p + i));
+		c = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+			_mm_cmpeq_epi8(v, bslash));
+		c = _mm_or_si128(c, _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+		bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(c) << i;
+	}
+
+	return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t escape_mask_avx2(const char *p)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i bslash = _mm256_set1_epi8('\\');
+	const __m256i ctrl = _mm256_set1_epi8(0x1f);
+	uint64_t bits = 0;
+	__m256i v, c;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(p + i));
+		c = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+			_mm256_cmpeq_epi8(v, bslash));
+		c = _mm256_or_si256(c,
+			_mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl));
+		bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(c) << i;
+	}
+
+	return bits;
+}
+
+/* bytes of multi-byte UTF-8 sequences, i.e. with the top bit set */
+__attribute__((target("sse4.2")))
+static uint64_t high_mask_sse42(const char *p)
+{
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i += 16)
+		bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+			_mm_loadu_si128((const __m128i *)(p + i))) << i;
+
+	return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t high_mask_avx2(const char *p)
+{
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i += 32)
+		bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i))) << i;
+
+	return bits;
+}
+#endif
+
+static uint64_t high_mask_scalar(const char *p)
+{
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i++)
+		if ((unsigned char)p[i] & 0x80)
+			bits |= (uint64_t)1 << i;
+
+	return bits;
+}
+
+static int is_escape(unsigned char c)
+{
+	return (c == '"') || (c == '\\') || (c < 0x20);
+}
+
+static uint64_t escape_mask_scalar(const char *p)
+{
+	uint64_t bits = 0;
+	int i;
+
+	for (i = 0; i < JSON_SCAN_BLOCK; i++)
+		if (is_escape((unsigned char)p[i]))
+			bits |= (uint64_t)1 << i;
+
+	return bits;
+}
+
+static uint64_t (*scan_mask)(const char *, unsigned int) = scan_mask_scalar;
+static uint64_t (*escape_mask)(const char *) = escape_mask_scalar;
+static uint64_t (*high_mask)(const char *) = high_mask_scalar;
+static const char *scan_impl = "scalar";
+
+/* pick the widest implementation the CPU supports before main() runs */
+__attribute__((constructor))
+static void json_scan_init(void)
+{
+#ifdef JSON_SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		scan_mask = scan_mask_avx2;
+		escape_mask = escape_mask_avx2;
+		high_mask = high_mask_avx2;
+		scan_impl = "avx2";
+	} else if (__builtin_cpu_supports("sse4.2")) {
+		scan_mask = scan_mask_sse42;
+		escape_mask = escape_mask_sse42;
+		high_mask = high_mask_sse42;
+		scan_impl = "sse4.2";
+	}
+#endif
+}
+
+uint64_t json_scan_mask(const char *p, unsigned int classes)
+{
+	return scan_mask(p, classes);
+}
+
+/* continue json_scan_find() past the short prefix, a block at a time */
+const char *json_scan_find_block(const char *p, const char *end,
+	unsigned int classes)
+{
+	uint64_t bits;
+
+	while (end - p >= JSON_SCAN_BLOCK) {
+		bits = scan_mask(p, classes);
+		if (bits)
+			return p + __builtin_ctzll(bits);
+		p += JSON_SCAN_BLOCK;
+	}
+
+	while ((p < end) && !(json_scan_class[(unsigned char)*p] & classes))
+		p++;
+
+	return p;
+}
+
+/* continue json_scan_skip() past the short prefix, a block at a time */
+const char *json_scan_skip_block(const char *p, const char *end,
+	unsigned int classes)
+{
+	uint64_t bits;
+
+	while (end - p >= JSON_SCAN_BLOCK) {
+		bits = ~scan_mask(p, classes);
+		if (bits)
+			return p + __builtin_ctzll(bits);
+		p += JSON_SCAN_BLOCK;
+	}
+
+	while ((p < end) && (json_scan_class[(unsigned char)*p] & classes))
+		p++;
+
+	return p;
+}
+
+/* one byte of json_scan_close(), returns 1 at the closing bracket */
+static int scan_close_byte(char c, size_t *depth, int *in_string)
+{
+	switch (c) {
+	case '\"':
+		*in_string = !*in_string;
+		break;
+	case '{':
+	case '[':
+		if (!*in_string)
+			(*depth)++;
+		break;
+	case '}':
+	case ']':
+		if (!*in_string && (--(*depth) == 0))
+			return 1;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Only the quotes, backslashes and brackets of a block are looked at, so
+ * a subtree is stepped over at the speed of the mask. Escaped characters
+ * are dropped from the mask, a backslash ending a block drops the first
+ * bit of the next one.
+ */
+const char *json_scan_close(const char *p, const char *end)
+{
+	const unsigned int classes = JSON_SCAN_QUOTE | JSON_SCAN_BACKSLASH |
+		JSON_SCAN_OPEN | JSON_SCAN_CLOSE;
+	size_t depth = 1;
+	int in_string = 0;
+	int escaped = 0;
+	uint64_t bits;
+	int i;
+
+	for (; end - p >= JSON_SCAN_BLOCK; p += JSON_SCAN_BLOCK) {
+		bits = scan_mask(p, classes);
+		if (escaped)
+			bits &= ~(uint64_t)1;
+		escaped = 0;
+		while (bits) {
+			i = __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if (p[i] == '\\') {
+				if (i == JSON_SCAN_BLOCK - 1)
+					escaped = 1;
+				else
+					bits &= ~((uint64_t)2 << i);
+			} else if (scan_close_byte(p[i], &depth, &in_string)) {
+				return p + i;
+			}
+		}
+	}
+
+	for (; p < end; p++) {
+		if (escaped)
+			escaped = 0;
+		else if (*p == '\\')
+			escaped = 1;
+		else if (scan_close_byte(*p, &depth, &in_string))
+			return p;
+	}
+
+	return end;
+}
+
+const char *json_scan_find_escape(const char *p, const char *end)
+{
+	uint64_t bits;
+
+	while (end - p >= JSON_SCAN_BLOCK) {
+		bits = escape_mask(p);
+		if (bits)
+			return p + __builtin_ctzll(bits);
+		p += JSON_SCAN_BLOCK;
+	}
+
+	while ((p < end) && !is_escape((unsigned char)*p))
+		p++;
+
+	return p;
+}
+
+/* length of the UTF-8 sequence at 'p', 0 if it is not well formed */
+static size_t utf8_seq(const unsigned char *p, const unsigned char *end)
+{
+	unsigned char c = p[0];
+	unsigned char lo = 0x80, hi = 0xbf;
+	size_t i, n;
+
+	if (c < 0x80)
+		return 1;
+	if ((c < 0xc2) || (c > 0xf4))
+		return 0;	/* continuation byte, overlong 2 bytes or > U+10FFFF */
+
+	if (c < 0xe0) {
+		n = 2;
+	} else if (c < 0xf0) {
+		n = 3;
+		if (c == 0xe0)
+			lo = 0xa0;	/* overlong */
+		else if (c == 0xed)
+			hi = 0x9f;	/* surrogates */
+	} else {
+		n = 4;
+		if (c == 0xf0)
+			lo = 0x90;	/* overlong */
+		else if (c == 0xf4)
+			hi = 0x8f;	/* > U+10FFFF */
+	}
+
+	if ((size_t)(end - p) < n)
+		return 0;
+	if ((p[1] < lo) || (p[1] > hi))
+		return 0;
+	for (i = 2; i < n; i++) {
+		if ((p[i] & 0xc0) != 0x80)
+			return 0;
+	}
+
+	return n;
+}
+
+const char *json_scan_utf8(const char *p, const char *end)
+{
+	size_t n;
+
+	while (p < end) {
+		/* ASCII runs are skipped a block at a time */
+		while ((end - p >= JSON_SCAN_BLOCK) && !high_mask(p))
+			p += JSON_SCAN_BLOCK;
+		if (p == end)
+			break;
+		if (!((unsigned char)*p & 0x80)) {
+			p++;
+			continue;
+		}
+		n = utf8_seq((const unsigned char *)p, (const unsigned char *)end);
+		if (!n)
+			return p;
+		p += n;
+	}
+
+	return end;
+}
+
+const char *json_scan_impl(void)
+{
+	return scan_impl;
+}
@@ -0,0 +1,87 @@
+#ifndef __JSON_SCAN_H__
+#define __JSON_SCAN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Byte classes used by the parse loops. Every byte maps to at most one
+ * class, blanks are split in two so that each class can be looked up from
+ * the high and low nibble of the byte independently.
+ */
+enum json_scan_class {
+	JSON_SCAN_QUOTE = 1 << 0,	/* '"' */
+	JSON_SCAN_BACKSLASH = 1 << 1,	/* '\\' */
+	JSON_SCAN_OPEN = 1 << 2,	/* '{' '[' */
+	JSON_SCAN_CLOSE = 1 << 3,	/* '}' ']' */
+	JSON_SCAN_COLON = 1 << 4,	/* ':' */
+	JSON_SCAN_COMMA = 1 << 5,	/* ',' */
+	JSON_SCAN_SPACE = 1 << 6,	/* ' ' */
+	JSON_SCAN_CTRL = 1 << 7,	/* '\t' '\n' '\r' */
+};
+
+#define JSON_SCAN_BLANK		(JSON_SCAN_SPACE | JSON_SCAN_CTRL)
+#define JSON_SCAN_STRUCTURAL	(JSON_SCAN_OPEN | JSON_SCAN_CLOSE | \
+				 JSON_SCAN_COLON | JSON_SCAN_COMMA)
+
+#define JSON_SCAN_BLOCK		64
+
+extern const uint8_t json_scan_class[256];
+
+/* bit i is set when p[i] belongs to one of 'classes', p has 64 bytes */
+uint64_t json_scan_mask(const char *p, unsigned int classes);
+
+const char *json_scan_find_block(const char *p, const char *end,
+	unsigned int classes);
+const char *json_scan_skip_block(const char *p, const char *end,
+	unsigned int classes);
+
+/* tokens and runs of blanks are mostly short, check them byte by byte */
+#define JSON_SCAN_SHORT		16
+
+/* first byte in [p, end) belonging to 'classes', or end */
+static inline const char *json_scan_find(const char *p, const char *end,
+	unsigned int classes)
+{
+	const char *q = (end - p > JSON_SCAN_SHORT) ? p + JSON_SCAN_SHORT : end;
+
+	while (p < q) {
+		if (json_scan_class[(unsigned char)*p] & classes)
+			return p;
+		p++;
+	}
+
+	return (p < end) ? json_scan_find_block(p, end, classes) : p;
+}
+
+/* first byte in [p, end) not belonging to 'classes', or end */
+static inline const char *json_scan_skip(const char *p, const char *end,
+	unsigned int classes)
+{
+	const char *q = (end - p > JSON_SCAN_SHORT) ? p + JSON_SCAN_SHORT : end;
+
+	while (p < q) {
+		if (!(json_scan_class[(unsigned char)*p] & classes))
+			return p;
+		p++;
+	}
+
+	return (p < end) ? json_scan_skip_block(p, end, classes) : p;
+}
+
+/*
+ * closing bracket matching the one just before 'p', or end, strings are
+ * stepped over and the kind of the brackets is not checked
+ */
+const char *json_scan_close(const char *p, const char *end);
+
+/* first byte in [p, end) that must be escaped in a JSON string, or end */
+const char *json_scan_find_escape(const char *p, const char *end);
+
+/* first byte in [p, end) of an ill-formed UTF-8 sequence, or end */
+const char *json_scan_utf8(const char *p, const char *end);
+
+/* name of the scanner picked at startup: "avx2", "sse4.2" or "scalar" */
+const char *json_scan_impl(void);
+
+#endif /* __JSON_SCAN_H__ */
@@ -0,0 +1,556 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "json_snap.h"
+#include "json_int.h"
+
+#define SNAP_MAGIC	0x504e534aU	/* "JSNP" */
+#define SNAP_VERSION	1
+#define SNAP_HASH_MIN	16
+
+/*
+ * File layout, every offset is relative to the start of its section:
+ *	struct snap_header
+ *	struct snap_node	nodes[nnodes], in document order, root first
+ *	uint32_t		child[nchild], children of every container
+ *	uint32_t		hash[nhash], name indexes of large objects
+ *	char			text[text_len], compact JSON of the document
+ */
+struct snap_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nnodes;
+	uint32_t nchild;
+	uint32_t nhash;
+	uint32_t text_len;
+};
+
+struct snap_node {
+	uint32_t type;
+	uint32_t nchild;
+	uint32_t child;		/* first entry in child[] */
+	uint32_t hash;		/* first slot in hash[] */
+	uint32_t hash_mask;	/* 0 without name index */
+	uint32_t name;		/* quoted name in text[], object members */
+	uint32_t name_len;
+	uint32_t value;
+	uint32_t value_len;
+};
+
+struct json_snap {
+	void *map;
+	size_t map_len;
+	const struct snap_header *hdr;
+	const struct snap_node *nodes;
+	const uint32_t *child;
+	const uint32_t *hash;
+	const char *text;
+};
+
+struct snap_build {
+	struct snap_node *nodes;
+	uint32_t nnodes;
+	uint32_t *child;
+	uint32_t nchild;
+	uint32_t *hash;
+	uint32_t nhash;
+	size_t hash_size;
+	char *text;
+	size_t text_len;
+	size_t text_size;
+};
+
+/* FNV-1a, the same as the document name index */
+static uint32_t snap_hash_name(const char *name, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	while (len--) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static int snap_count(json_data *d, size_t *n)
+{
+	json_data *p;
+
+	(*n)++;
+	if ((d->type != OBJECT) && (d->type != ARRAY))
+		return 0;
+
+	if (json_data_get_count(d) < 0)
+		return -1;
+
+	TAILQ_FOREACH(p, &d->head, next) {
+		if (snap_count(p, n))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int snap_put(struct snap_build *b, const char *p, size_t len)
+{
+	char *n;
+	size_t size;
+
+	if (b->text_len + len > UINT32_MAX) {
+		json_error_set(JSON_ERR_LIMIT,
+			"document is too large for a snapshot", NULL);
+		return -1;
+	}
+
+	if (b->text_len + len > b->text_size) {
+		size = b->text_size ? b->text_size * 2 : 4096;
+		while (size < b->text_len + len)
+			size *= 2;
+		n = (char *)realloc(b->text, size);
+		if (!n) {
+			json_error_sys(JSON_ERR_NOMEM, "realloc snapshot text error");
+			return -1;
+		}
+		b->text = n;
+		b->text_size = size;
+	}
+	memcpy(b->text + b->text_len, p, len);
+	b->text_len += len;
+
+	return 0;
+}
+
+static int snap_hash_build(struct snap_build *b, struct snap_node *n)
+{
+	const struct snap_node *c;
+	uint32_t *slots;
+	size_t size = 16;
+	uint32_t i, k;
+
+	while (size < (size_t)n->nchild * 2)
+		size *= 2;
+
+	if (b->nhash + size > b->hash_size) {
+		b->hash_size = (b->nhash + size) * 2;
+		slots = (uint32_t *)realloc(b->hash,
+			b->hash_size * sizeof(*slots));
+		if (!slots) {
+			json_error_sys(JSON_ERR_NOMEM, "realloc snapshot hash error");
+			return -1;
+		}
+		b->hash = slots;
+	}
+	slots = b->hash + b->nhash;
+	memset(slots, 0xff, size * sizeof(*slots));
+
+	for (k = 0; k < n->nchild; k++) {
+		c = &b->nodes[b->child[n->child + k]];
+		i = snap_hash_name(b->text + c->name + 1, c->name_len - 2) &
+			(size - 1);
+		while (slots[i] != JSON_SNAP_NONE) {
+			/* the first of duplicated names wins, as in the tree */
+			if ((b->nodes[slots[i]].name_len == c->name_len) &&
+				!memcmp(b->text + b->nodes[slots[i]].name,
+					b->text + c->name, c->name_len))
+				break;
+			i = (i + 1) & (size - 1);
+		}
+		if (slots[i] == JSON_SNAP_NONE)
+			slots[i] = b->child[n->child + k];
+	}
+
+	n->hash = b->nhash;
+	n->hash_mask = size - 1;
+	b->nhash += size;
+
+	return 0;
+}
+
+/* append 'd' as node 'idx', its name is already in the text */
+static int snap_add(struct snap_build *b, json_data *d, uint32_t idx)
+{
+	struct snap_node *n = &b->nodes[idx];
+	json_data *p;
+	uint32_t c;
+
+	n->type = d->type;
+	n->value = b->text_len;
+
+	if ((d->type != OBJECT) && (d->type != ARRAY)) {
+		if (snap_put(b, d->value.p, d->value.len))
+			return -1;
+		n->value_len = d->value.len;
+		return 0;
+	}
+
+	n->nchild = d->nchild;
+	n->child = b->nchild;
+	b->nchild += d->nchild;
+
+	if (snap_put(b, (d->type == OBJECT) ? "{" : "[", 1))
+		return -1;
+
+	c = n->child;
+	TAILQ_FOREACH(p, &d->head, next) {
+		if ((c != n->child) && snap_put(b, ",", 1))
+			return -1;
+		b->child[c] = b->nnodes++;
+		if (d->type == OBJECT) {
+			b->nodes[b->child[c]].name = b->text_len;
+			b->nodes[b->child[c]].name_len = p->name.len;
+			if (snap_put(b, p->name.p, p->name.len) ||
+				snap_put(b, ":", 1))
+				return -1;
+		}
+		if (snap_add(b, p, b->child[c]))
+			return -1;
+		c++;
+	}
+
+	if (snap_put(b, (d->type == OBJECT) ? "}" : "]", 1))
+		return -1;
+	n->value_len = b->text_len - n->value;
+
+	if ((d->type == OBJECT) && (n->nchild >= SNAP_HASH_MIN))
+		return snap_hash_build(b, n);
+
+	return 0;
+}
+
+static int snap_write(int fd, const void *p, size_t len)
+{
+	const char *s = (const char *)p;
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, s, len);
+		if (n < 0) {
+			json_error_sys(JSON_ERR_IO, "write error");
+			return -1;
+		}
+		s += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int json_snap_save(json_data *root, const char *file)
+{
+	struct snap_build b;
+	struct snap_header hdr;
+	size_t n = 0;
+	char *tmp = NULL;
+	int fd;
+	int ret = -1;
+
+	if (!root || !file) {
+		json_error_set(JSON_ERR_ARG, "json data or file is not specified",
+			NULL);
+		return -1;
+	}
+
+	if (snap_count(root, &n))
+		return -1;
+	if (n >= JSON_SNAP_NONE) {
+		json_error_set(JSON_ERR_LIMIT,
+			"document is too large for a snapshot", NULL);
+		return -1;
+	}
+
+	memset(&b, 0, sizeof(b));
+	b.nodes = (struct snap_node *)calloc(n, sizeof(*b.nodes));
+	b.child = (uint32_t *)malloc(n * sizeof(*b.child));
+	if (!b.nodes || !b.child) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc snapshot error");
+		goto end;
+	}
+
+	b.nnodes = 1;
+	if (snap_add(&b, root, 0))
+		goto end;
+
+	/*
+	 * readers may have the old snapshot mapped, it is replaced whole by
+	 * a rename and never truncated under them
+	 */
+	tmp = (char *)malloc(strlen(file) + sizeof(".XXXXXX"));
+	if (!tmp) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc snapshot error");
+		goto end;
+	}
+	sprintf(tmp, "%s.XXXXXX", file);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		json_error_sys(JSON_ERR_IO, "mkstemp error");
+		free(tmp);
+		tmp = NULL;
+		goto end;
+	}
+	if (fchmod(fd, 0644)) {
+		json_error_sys(JSON_ERR_IO, "fchmod error");
+		close(fd);
+		goto end;
+	}
+
+	hdr.magic = SNAP_MAGIC;
+	hdr.version = SNAP_VERSION;
+	hdr.nnodes = b.nnodes;
+	hdr.nchild = b.nchild;
+	hdr.nhash = b.nhash;
+	hdr.text_len = b.text_len;
+	if (!snap_write(fd, &hdr, sizeof(hdr)) &&
+		!snap_write(fd, b.nodes, b.nnodes * sizeof(*b.nodes)) &&
+		!snap_write(fd, b.child, b.nchild * sizeof(*b.child)) &&
+		!snap_write(fd, b.hash, b.nhash * sizeof(*b.hash)) &&
+		!snap_write(fd, b.text, b.text_len))
+		ret = 0;
+	if (!ret && fsync(fd)) {
+		json_error_sys(JSON_ERR_IO, "fsync error");
+		ret = -1;
+	}
+	if (close(fd) && !ret) {
+		json_error_sys(JSON_ERR_IO, "close error");
+		ret = -1;
+	}
+	if (!ret && rename(tmp, file)) {
+		json_error_sys(JSON_ERR_IO, "rename error");
+		ret = -1;
+	}
+
+end:
+	if (tmp) {
+		if (ret)
+			unlink(tmp);
+		free(tmp);
+	}
+	free(b.nodes);
+	free(b.child);
+	free(b.hash);
+	free(b.text);
+	return ret;
+}
+
+struct json_snap *json_snap_open(const char *file)
+{
+	const struct snap_header *hdr;
+	struct json_snap *s;
+	size_t len, need;
+	void *p;
+	int fd;
+
+	if (!file) {
+		json_error_set(JSON_ERR_ARG, "file is not specified", NULL);
+		return NULL;
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		json_error_sys(JSON_ERR_IO, "open error");
+		return NULL;
+	}
+
+	len = lseek(fd, 0, SEEK_END);
+	if (len < sizeof(*hdr)) {
+		json_error_set(JSON_ERR_IO, "file is not a snapshot", NULL);
+		close(fd);
+		return NULL;
+	}
+
+	p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		json_error_sys(JSON_ERR_IO, "mmap error");
+		return NULL;
+	}
+
+	hdr = (const struct snap_header *)p;
+	need = sizeof(*hdr) + (size_t)hdr->nnodes * sizeof(struct snap_node) +
+		((size_t)hdr->nchild + hdr->nhash) * sizeof(uint32_t) +
+		hdr->text_len;
+	if ((hdr->magic != SNAP_MAGIC) || (hdr->version != SNAP_VERSION) ||
+		(hdr->nnodes == 0) || (need != len)) {
+		json_error_set(JSON_ERR_IO, "file is not a snapshot", NULL);
+		munmap(p, len);
+		return NULL;
+	}
+
+	s = (struct json_snap *)malloc(sizeof(*s));
+	if (!s) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc snapshot error");
+		munmap(p, len);
+		return NULL;
+	}
+	s->map = p;
+	s->map_len = len;
+	s->hdr = hdr;
+	s->nodes = (const struct snap_node *)(hdr + 1);
+	s->child = (const uint32_t *)(s->nodes + hdr->nnodes);
+	s->hash = s->child + hdr->nchild;
+	s->text = (const char *)(s->hash + hdr->nhash);
+
+	return s;
+}
+
+void json_snap_close(struct json_snap *s)
+{
+	if (s) {
+		munmap(s->map, s->map_len);
+		free(s);
+	}
+}
+
+static const struct snap_node *snap_node(struct json_snap *s,
+	json_snap_node node)
+{
+	if (!s || (node >= s->hdr->nnodes))
+		return NULL;
+
+	return &s->nodes[node];
+}
+
+json_snap_node json_snap_root(struct json_snap *s)
+{
+	return s ? 0 : JSON_SNAP_NONE;
+}
+
+enum json_type json_snap_type(struct json_snap *s, json_snap_node node)
+{
+	const struct snap_node *n = snap_node(s, node);
+
+	return n ? (enum json_type)n->type : MISC;
+}
+
+int json_snap_count(struct json_snap *s, json_snap_node node)
+{
+	const struct snap_node *n = snap_node(s, node);
+
+	if (!n || ((n->type != OBJECT) && (n->type != ARRAY)))
+		return -1;
+
+	return (int)n->nchild;
+}
+
+static int snap_name_equal(struct json_snap *s, const struct snap_node *n,
+	const char *name, size_t len)
+{
+	return (n->name_len == len + 2) &&
+		!memcmp(s->text + n->name + 1, name, len);
+}
+
+json_snap_node json_snap_get_by_name(struct json_snap *s, json_snap_node node,
+	const char *name)
+{
+	const struct snap_node *n = snap_node(s, node);
+	json_snap_node c;
+	size_t len;
+	uint32_t i;
+
+	if (!n || !name || (n->type != OBJECT))
+		return JSON_SNAP_NONE;
+
+	len = strlen(name);
+
+	if (n->hash_mask) {
+		i = snap_hash_name(name, len) & n->hash_mask;
+		while ((c = s->hash[n->hash + i]) != JSON_SNAP_NONE) {
+			if (snap_name_equal(s, &s->nodes[c], name, len))
+				return c;
+			i = (i + 1) & n->hash_mask;
+		}
+		return JSON_SNAP_NONE;
+	}
+
+	for (i = 0; i < n->nchild; i++) {
+		c = s->child[n->child + i];
+		if (snap_name_equal(s, &s->nodes[c], name, len))
+			return c;
+	}
+
+	return JSON_SNAP_NONE;
+}
+
+json_snap_node json_snap_get_by_index(struct json_snap *s, json_snap_node node,
+	int idx)
+{
+	const struct snap_node *n = snap_node(s, node);
+
+	if (!n || (n->type != ARRAY) || (idx < 0) || ((uint32_t)idx >= n->nchild))
+		return JSON_SNAP_NONE;
+
+	return s->child[n->child + idx];
+}
+
+int json_snap_value(struct json_snap *s, json_snap_node node, buf_t *val)
+{
+	const struct snap_node *n = snap_node(s, node);
+
+	if (!n || !val)
+		return -1;
+
+	val->p = (char *)s->text + n->value;
+	val->len = n->value_len;
+
+	return 0;
+}
+
+/* a node-less json_data view, enough for the json_data_to_*() helpers */
+static int snap_view(struct json_snap *s, json_snap_node node, json_data *d)
+{
+	const struct snap_node *n = snap_node(s, node);
+
+	if (!n)
+		return -1;
+
+	memset(d, 0, sizeof(*d));
+	d->type = (enum json_type)n->type;
+	d->value.p = (char *)s->text + n->value;
+	d->value.len = n->value_len;
+
+	return ((d->type == OBJECT) || (d->type == ARRAY)) ? -1 : 0;
+}
+
+int json_snap_to_int64(struct json_snap *s, json_snap_node node, int64_t *val)
+{
+	json_data d;
+
+	if (snap_view(s, node, &d))
+		return -1;
+
+	return json_data_to_int64(&d, val);
+}
+
+int json_snap_to_uint64(struct json_snap *s, json_snap_node node,
+	uint64_t *val)
+{
+	json_data d;
+
+	if (snap_view(s, node, &d))
+		return -1;
+
+	return json_data_to_uint64(&d, val);
+}
+
+int json_snap_to_double(struct json_snap *s, json_snap_node node, double *val)
+{
+	json_data d;
+
+	if (snap_view(s, node, &d))
+		return -1;
+
+	return json_data_to_double(&d, val);
+}
+
+int json_snap_to_string(struct json_snap *s, json_snap_node node, char *str,
+	size_t size)
+{
+	json_data d;
+
+	if (snap_view(s, node, &d))
+		return -1;
+
+	return json_data_to_string(&d, str, size);
+}
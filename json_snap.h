@@ -0,0 +1,44 @@
+#ifndef __JSON_SNAP_H__
+#define __JSON_SNAP_H__
+
+#include "json.h"
+
+/*
+ * Binary snapshot of a parsed document. json_snap_save() writes the node
+ * index, child tables, name indexes and a compact copy of the text into a
+ * file made of offsets only, json_snap_open() maps it read-only and the
+ * lookups below run on the mapping without parsing or allocating. The file
+ * uses the byte order of the machine that wrote it. Only the section sizes
+ * are checked on open, so snapshots must come from a trusted writer.
+ * json_snap_save() writes a temporary file next to 'file' and renames it
+ * over 'file', so a snapshot that is open keeps its old content.
+ */
+struct json_snap;
+
+typedef uint32_t json_snap_node;
+
+#define JSON_SNAP_NONE	((json_snap_node)-1)
+
+int json_snap_save(json_data *root, const char *file);
+struct json_snap *json_snap_open(const char *file);
+void json_snap_close(struct json_snap *snap);
+
+json_snap_node json_snap_root(struct json_snap *snap);
+enum json_type json_snap_type(struct json_snap *snap, json_snap_node node);
+int json_snap_count(struct json_snap *snap, json_snap_node node);
+json_snap_node json_snap_get_by_name(struct json_snap *snap,
+	json_snap_node node, const char *name);
+json_snap_node json_snap_get_by_index(struct json_snap *snap,
+	json_snap_node node, int idx);
+/* text of the value in the mapping, strings keep their quotes */
+int json_snap_value(struct json_snap *snap, json_snap_node node, buf_t *val);
+int json_snap_to_int64(struct json_snap *snap, json_snap_node node,
+	int64_t *val);
+int json_snap_to_uint64(struct json_snap *snap, json_snap_node node,
+	uint64_t *val);
+int json_snap_to_double(struct json_snap *snap, json_snap_node node,
+	double *val);
+int json_snap_to_string(struct json_snap *snap, json_snap_node node,
+	char *str, size_t size);
+
+#endif /* __JSON_SNAP_H__ */
@@ -0,0 +1,120 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "json_int.h"
+#include "json_stats.h"
+#include "queue.h"
+
+#ifdef JSON_STATS
+
+struct stats_slot {
+	struct json_stats c;
+	TAILQ_ENTRY(stats_slot) next;
+};
+
+static TAILQ_HEAD(, stats_slot) slots = TAILQ_HEAD_INITIALIZER(slots);
+static struct json_stats retired;	/* of the threads that exited */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static __thread struct stats_slot *local;
+
+#define STATS_N	(sizeof(struct json_stats) / sizeof(uint64_t))
+
+static void stats_sum(struct json_stats *to, struct json_stats *from)
+{
+	uint64_t *t = (uint64_t *)to;
+	uint64_t *f = (uint64_t *)from;
+	size_t i;
+
+	for (i = 0; i < STATS_N; i++)
+		t[i] += __atomic_load_n(&f[i], __ATOMIC_RELAXED);
+}
+
+/* fold the counters of an exiting thread into 'retired' */
+static void stats_exit(void *data)
+{
+	struct stats_slot *s = (struct stats_slot *)data;
+
+	pthread_mutex_lock(&stats_lock);
+	stats_sum(&retired, &s->c);
+	TAILQ_REMOVE(&slots, s, next);
+	pthread_mutex_unlock(&stats_lock);
+	free(s);
+}
+
+static void stats_key_init(void)
+{
+	pthread_key_create(&stats_key, stats_exit);
+}
+
+struct json_stats *json_stats_local(void)
+{
+	struct stats_slot *s = local;
+
+	if (s)
+		return &s->c;
+
+	s = (struct stats_slot *)calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	pthread_once(&stats_once, stats_key_init);
+	pthread_mutex_lock(&stats_lock);
+	TAILQ_INSERT_TAIL(&slots, s, next);
+	pthread_mutex_unlock(&stats_lock);
+	pthread_setspecific(stats_key, s);
+	local = s;
+
+	return &s->c;
+}
+
+int json_stats_get(struct json_stats *stats)
+{
+	struct stats_slot *s;
+
+	if (!stats)
+		return -1;
+
+	memset(stats, 0, sizeof(*stats));
+	pthread_mutex_lock(&stats_lock);
+	stats_sum(stats, &retired);
+	TAILQ_FOREACH(s, &slots, next)
+		stats_sum(stats, &s->c);
+	pthread_mutex_unlock(&stats_lock);
+
+	return 0;
+}
+
+/* an add racing with the reset lands either before it or after it */
+void json_stats_reset(void)
+{
+	struct stats_slot *s;
+	uint64_t *c;
+	size_t i;
+
+	pthread_mutex_lock(&stats_lock);
+	memset(&retired, 0, sizeof(retired));
+	TAILQ_FOREACH(s, &slots, next) {
+		c = (uint64_t *)&s->c;
+		for (i = 0; i < STATS_N; i++)
+			__atomic_store_n(&c[i], 0, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+#else
+
+int json_stats_get(struct json_stats *stats)
+{
+	if (stats)
+		memset(stats, 0, sizeof(*stats));
+
+	return -1;
+}
+
+void json_stats_reset(void)
+{
+}
+
+#endif /* JSON_STATS */
@@ -0,0 +1,25 @@
+#ifndef __JSON_STATS_H__
+#define __JSON_STATS_H__
+
+#include <stdint.h>
+
+/*
+ * Counters of the work done by the library, kept per thread and summed by
+ * json_stats_get(). They are only maintained when the library is built
+ * with JSON_STATS defined ("make STATS=1"), otherwise the hooks compile to
+ * nothing and json_stats_get() reports zeros.
+ */
+struct json_stats {
+	uint64_t bytes_scanned;		/* by the parse and lazy re-scans */
+	uint64_t nodes;			/* json_data allocated */
+	uint64_t materializations;	/* containers whose children were built */
+	uint64_t lookups;		/* get_by_name() and get_by_index() */
+	uint64_t lookup_probes;		/* members compared or slots probed */
+	uint64_t conversion_failures;	/* json_data_to_*() errors */
+};
+
+/* returns -1 when the counters are compiled out */
+int json_stats_get(struct json_stats *stats);
+void json_stats_reset(void);
+
+#endif /* __JSON_STATS_H__ */
@@ -0,0 +1,392 @@
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "json_watch.h"
+#include "json_int.h"
+
+#define DIFF_PATH_MAX	4096
+
+struct diff_ctx {
+	json_diff_cb cb;
+	void *arg;
+	int count;
+	size_t len;			/* of 'path' */
+	char path[DIFF_PATH_MAX];
+	char name[DIFF_PATH_MAX];	/* NUL terminated member name */
+};
+
+struct json_watch {
+	char *file;
+	const char *base;	/* name of the file in its directory */
+	unsigned int flags;
+	json_diff_cb cb;
+	void *arg;
+	int fd;
+	json_data *doc;
+};
+
+static int diff_value(struct diff_ctx *c, json_data *a, json_data *b);
+
+static int diff_report(struct diff_ctx *c, enum json_diff_op op,
+	json_data *a, json_data *b)
+{
+	c->count++;
+	if (c->cb && c->cb(c->arg, op, c->len ? c->path : "", a, b))
+		return -1;
+
+	return 0;
+}
+
+/* appends "/name" with '~' and '/' escaped, or "/idx" when name is NULL */
+static int diff_push(struct diff_ctx *c, buf_t *name, int idx)
+{
+	size_t len = c->len;
+	size_t i, n;
+	char *p;
+
+	if (!name) {
+		n = snprintf(c->path + len, sizeof(c->path) - len, "/%d", idx);
+		if (n >= sizeof(c->path) - len)
+			goto err;
+		c->len += n;
+		return 0;
+	}
+
+	/* names keep their quotes in json_data */
+	p = name->p + 1;
+	n = name->len - 2;
+	if (len + 1 >= sizeof(c->path))
+		goto err;
+	c->path[len++] = '/';
+	for (i = 0; i < n; i++) {
+		if (len + 2 >= sizeof(c->path))
+			goto err;
+		if (p[i] == '~') {
+			c->path[len++] = '~';
+			c->path[len++] = '0';
+		} else if (p[i] == '/') {
+			c->path[len++] = '~';
+			c->path[len++] = '1';
+		} else {
+			c->path[len++] = p[i];
+		}
+	}
+	c->path[len] = '\0';
+	c->len = len;
+
+	return 0;
+
+err:
+	json_error_set(JSON_ERR_LIMIT, "path of a difference is too long", NULL);
+	return -1;
+}
+
+static void diff_pop(struct diff_ctx *c, size_t len)
+{
+	c->len = len;
+	c->path[len] = '\0';
+}
+
+/* the member of 'obj' named like 'e', NULL when there is none */
+static json_data *diff_member(struct diff_ctx *c, json_data *obj,
+	json_data *e)
+{
+	size_t n = e->name.len - 2;
+
+	if (n >= sizeof(c->name))
+		return NULL;
+	memcpy(c->name, e->name.p + 1, n);
+	c->name[n] = '\0';
+
+	return json_data_get_by_name(obj, c->name);
+}
+
+static int diff_object(struct diff_ctx *c, json_data *a, json_data *b)
+{
+	size_t len = c->len;
+	json_data *e, *f;
+	int ret = 0;
+
+	if ((json_data_get_count(a) < 0) || (json_data_get_count(b) < 0))
+		return -1;
+
+	TAILQ_FOREACH(e, &a->head, next) {
+		if (diff_push(c, &e->name, 0))
+			return -1;
+		f = diff_member(c, b, e);
+		ret = f ? diff_value(c, e, f) :
+			diff_report(c, JSON_DIFF_REMOVED, e, NULL);
+		diff_pop(c, len);
+		if (ret)
+			return -1;
+	}
+
+	TAILQ_FOREACH(f, &b->head, next) {
+		if (diff_member(c, a, f))
+			continue;
+		if (diff_push(c, &f->name, 0))
+			return -1;
+		ret = diff_report(c, JSON_DIFF_ADDED, NULL, f);
+		diff_pop(c, len);
+		if (ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* elements are compared by index, a shift shows as changes */
+static int diff_array(struct diff_ctx *c, json_data *a, json_data *b)
+{
+	size_t len = c->len;
+	json_data *e, *f;
+	int i = 0;
+	int ret;
+
+	if ((json_data_get_count(a) < 0) || (json_data_get_count(b) < 0))
+		return -1;
+
+	e = TAILQ_FIRST(&a->head);
+	f = TAILQ_FIRST(&b->head);
+	for (; e || f; i++) {
+		if (diff_push(c, NULL, i))
+			return -1;
+		if (e && f)
+			ret = diff_value(c, e, f);
+		else if (e)
+			ret = diff_report(c, JSON_DIFF_REMOVED, e, NULL);
+		else
+			ret = diff_report(c, JSON_DIFF_ADDED, NULL, f);
+		diff_pop(c, len);
+		if (ret)
+			return -1;
+		if (e)
+			e = TAILQ_NEXT(e, next);
+		if (f)
+			f = TAILQ_NEXT(f, next);
+	}
+
+	return 0;
+}
+
+static int diff_value(struct diff_ctx *c, json_data *a, json_data *b)
+{
+	if (a->type != b->type)
+		return diff_report(c, JSON_DIFF_CHANGED, a, b);
+
+	/* the text of a modified subtree is stale, its nodes are compared */
+	if (!a->dirty && !b->dirty && (a->value.len == b->value.len) &&
+		!memcmp(a->value.p, b->value.p, a->value.len))
+		return 0;
+
+	switch (a->type) {
+	case OBJECT:
+		return diff_object(c, a, b);
+	case ARRAY:
+		return diff_array(c, a, b);
+	default:
+		return diff_report(c, JSON_DIFF_CHANGED, a, b);
+	}
+}
+
+int json_data_diff(json_data *old, json_data *cur, json_diff_cb cb,
+	void *arg)
+{
+	struct diff_ctx *c;
+	int ret;
+
+	if (!old || !cur) {
+		json_error_set(JSON_ERR_ARG, "json data is not specified", NULL);
+		return -1;
+	}
+
+	/* the path buffers are too large for the stack of a callback */
+	c = (struct diff_ctx *)malloc(sizeof(*c));
+	if (!c) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc diff error");
+		return -1;
+	}
+	c->cb = cb;
+	c->arg = arg;
+	c->count = 0;
+	c->len = 0;
+	c->path[0] = '\0';
+
+	ret = diff_value(c, old, cur);
+	if (!ret)
+		ret = c->count;
+	free(c);
+
+	return ret;
+}
+
+struct json_watch *json_watch_new(const char *file, unsigned int flags,
+	json_diff_cb cb, void *arg)
+{
+	struct json_watch *w;
+	char *slash;
+	const char *dir;
+
+	if (!file) {
+		json_error_set(JSON_ERR_ARG, "file is not specified", NULL);
+		return NULL;
+	}
+
+	w = (struct json_watch *)calloc(1, sizeof(*w));
+	if (!w) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc watch error");
+		return NULL;
+	}
+	w->fd = -1;
+	/* a mapped version would change under the diff, or fault when cut */
+	w->flags = flags & ~JSON_PARSE_MMAP;
+	w->cb = cb;
+	w->arg = arg;
+
+	/* "dir/name" becomes "dir\0name" for inotify_add_watch() */
+	w->file = strdup(file);
+	if (!w->file) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc watch error");
+		goto err;
+	}
+
+	w->doc = json_data_from_file_ex(w->file, w->flags);
+	if (!w->doc)
+		goto err;
+
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->fd < 0) {
+		json_error_sys(JSON_ERR_IO, "inotify_init1 error");
+		goto err;
+	}
+
+	slash = strrchr(w->file, '/');
+	if (slash == w->file) {
+		dir = "/";
+		w->base = slash + 1;
+	} else if (slash) {
+		*slash = '\0';
+		dir = w->file;
+		w->base = slash + 1;
+	} else {
+		dir = ".";
+		w->base = w->file;
+	}
+	/* an editor may write a new file and rename it over the old one */
+	if (inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		json_error_sys(JSON_ERR_IO, "inotify_add_watch error");
+		goto err;
+	}
+	if (slash && (slash != w->file))
+		*slash = '/';
+
+	return w;
+
+err:
+	json_watch_free(w);
+	return NULL;
+}
+
+json_data *json_watch_doc(struct json_watch *w)
+{
+	return w ? w->doc : NULL;
+}
+
+int json_watch_fd(struct json_watch *w)
+{
+	return w ? w->fd : -1;
+}
+
+int json_watch_reload(struct json_watch *w)
+{
+	json_data *d;
+	int ret;
+
+	if (!w)
+		return -1;
+
+	d = json_data_from_file_ex(w->file, w->flags);
+	if (!d)
+		return -1;
+
+	ret = json_data_diff(w->doc, d, w->cb, w->arg);
+	if (ret < 0) {
+		json_data_free(d);
+		return -1;
+	}
+	json_data_free(w->doc);
+	w->doc = d;
+
+	return ret;
+}
+
+/* drains the pending events, returns 1 when one names the file */
+static int watch_events(struct json_watch *w)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t n;
+	char *p;
+	int hit = 0;
+
+	for (;;) {
+		n = read(w->fd, buf, sizeof(buf));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			json_error_sys(JSON_ERR_IO, "read inotify error");
+			return -1;
+		}
+		for (p = buf; p < buf + n; p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if (ev->len && !strcmp(ev->name, w->base))
+				hit = 1;
+		}
+	}
+
+	return hit;
+}
+
+int json_watch_poll(struct json_watch *w, int timeout)
+{
+	struct pollfd pfd;
+	int ret;
+
+	if (!w)
+		return -1;
+
+	pfd.fd = w->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	ret = poll(&pfd, 1, timeout);
+	if (ret < 0) {
+		if (errno == EINTR)
+			return 0;
+		json_error_sys(JSON_ERR_IO, "poll error");
+		return -1;
+	}
+	if (ret == 0)
+		return 0;
+
+	ret = watch_events(w);
+	if (ret <= 0)
+		return ret;
+
+	return json_watch_reload(w);
+}
+
+void json_watch_free(struct json_watch *w)
+{
+	if (!w)
+		return;
+
+	if (w->fd >= 0)
+		close(w->fd);
+	json_data_free(w->doc);
+	free(w->file);
+	free(w);
+}
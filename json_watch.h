@@ -0,0 +1,56 @@
+#ifndef __JSON_WATCH_H__
+#define __JSON_WATCH_H__
+
+#include "json.h"
+
+/*
+ * Reload of a file when it changes on disk. The directory of the file is
+ * watched with inotify, so editors that replace the file are seen as well.
+ * A new version is parsed, compared with the previous one and only the
+ * values that differ are reported, as RFC 6901 pointers that
+ * json_path_compile() accepts. Subtrees whose text did not change are
+ * recognized by comparing bytes and are never materialized.
+ */
+enum json_diff_op {
+	JSON_DIFF_ADDED = 0,	/* 'old' is NULL */
+	JSON_DIFF_REMOVED,	/* 'cur' is NULL */
+	JSON_DIFF_CHANGED,	/* a scalar or the type of the value changed */
+};
+
+/*
+ * Called for every difference, the nodes and 'path' are only valid during
+ * the call. Member names are used as they are in the text, escapes are
+ * not decoded. A non-zero return stops the comparison.
+ */
+typedef int (*json_diff_cb)(void *arg, enum json_diff_op op,
+	const char *path, json_data *old, json_data *cur);
+
+/* returns the number of differences, or -1 */
+int json_data_diff(json_data *old, json_data *cur, json_diff_cb cb,
+	void *arg);
+
+struct json_watch;
+
+/*
+ * the first version is parsed here, 'flags' are json_parse_flags.
+ * JSON_PARSE_MMAP is ignored, every version is a copy of the file, as the
+ * file is rewritten while the previous version is still compared.
+ */
+struct json_watch *json_watch_new(const char *file, unsigned int flags,
+	json_diff_cb cb, void *arg);
+/* the current version, it is freed by the next reload that succeeds */
+json_data *json_watch_doc(struct json_watch *w);
+/* the inotify descriptor, readable when json_watch_poll() has work */
+int json_watch_fd(struct json_watch *w);
+/*
+ * Waits up to 'timeout' ms, -1 for ever, for the file to change and
+ * reloads it. Returns the number of differences, 0 when the file did not
+ * change, or -1. A version that fails to parse is ignored and the
+ * previous one is kept.
+ */
+int json_watch_poll(struct json_watch *w, int timeout);
+/* reloads now, whether the file changed or not */
+int json_watch_reload(struct json_watch *w);
+void json_watch_free(struct json_watch *w);
+
+#endif /* __JSON_WATCH_H__ */
@@ -0,0 +1,965 @@
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "json_write.h"
+#include "json_int.h"
+#include "json_scan.h"
+
+#define WRITE_BUF_SIZE	65536
+
+enum writer_sink {
+	SINK_BUF = 0,
+	SINK_FD,
+	SINK_CB,
+};
+
+/* state of an open container */
+#define ITEM_WRITTEN	0x1	/* a member or element was written */
+#define ITEM_OBJECT	0x2	/* '{', members need a name */
+
+struct json_writer {
+	enum writer_sink sink;
+	unsigned int flags;
+	int fd;
+	json_write_cb cb;
+	void *arg;
+	char *buf;
+	size_t len;
+	size_t size;
+	unsigned char *items;	/* ITEM_* of every open container */
+	size_t depth;
+	size_t items_size;
+	int after_name;		/* the value of a member comes next */
+	int started;		/* a top-level value was written */
+	int error;
+};
+
+static struct json_writer *writer_new(enum writer_sink sink, unsigned int flags)
+{
+	struct json_writer *w;
+
+	w = (struct json_writer *)calloc(1, sizeof(*w));
+	if (!w) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc writer error");
+		return NULL;
+	}
+	w->buf = (char *)malloc(WRITE_BUF_SIZE);
+	if (!w->buf) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc writer buffer error");
+		free(w);
+		return NULL;
+	}
+	w->size = WRITE_BUF_SIZE;
+	w->sink = sink;
+	w->flags = flags;
+	w->fd = -1;
+
+	return w;
+}
+
+struct json_writer *json_writer_new_buf(unsigned int flags)
+{
+	return writer_new(SINK_BUF, flags);
+}
+
+struct json_writer *json_writer_new_fd(int fd, unsigned int flags)
+{
+	struct json_writer *w = writer_new(SINK_FD, flags);
+
+	if (w)
+		w->fd = fd;
+
+	return w;
+}
+
+struct json_writer *json_writer_new_cb(json_write_cb cb, void *arg,
+	unsigned int flags)
+{
+	struct json_writer *w;
+
+	if (!cb) {
+		json_error_set(JSON_ERR_ARG, "callback is not specified", NULL);
+		return NULL;
+	}
+
+	w = writer_new(SINK_CB, flags);
+	if (w) {
+		w->cb = cb;
+		w->arg = arg;
+	}
+
+	return w;
+}
+
+/* hand 'len' bytes to the fd or the callback */
+static int writer_out(struct json_writer *w, const char *p, size_t len)
+{
+	ssize_t n;
+
+	if (w->sink == SINK_CB) {
+		if (w->cb(w->arg, p, len))
+			w->error = 1;
+	} else {
+		while (len) {
+			n = write(w->fd, p, len);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				json_error_sys(JSON_ERR_IO, "write error");
+				w->error = 1;
+				break;
+			}
+			p += n;
+			len -= n;
+		}
+	}
+
+	return w->error ? -1 : 0;
+}
+
+int json_writer_flush(struct json_writer *w)
+{
+	int ret;
+
+	if (!w || w->error)
+		return -1;
+
+	if ((w->sink == SINK_BUF) || (w->len == 0))
+		return 0;
+
+	ret = writer_out(w, w->buf, w->len);
+	w->len = 0;
+
+	return ret;
+}
+
+/* make room for 'len' more bytes */
+static int writer_reserve(struct json_writer *w, size_t len)
+{
+	char *n;
+	size_t size;
+
+	if (w->len + len <= w->size)
+		return 0;
+
+	if (w->sink != SINK_BUF) {
+		if (json_writer_flush(w))
+			return -1;
+		if (len <= w->size)
+			return 0;
+	}
+
+	size = w->size * 2;
+	while (size < w->len + len)
+		size *= 2;
+	n = (char *)realloc(w->buf, size);
+	if (!n) {
+		json_error_sys(JSON_ERR_NOMEM, "realloc writer buffer error");
+		w->error = 1;
+		return -1;
+	}
+	w->buf = n;
+	w->size = size;
+
+	return 0;
+}
+
+static int writer_put(struct json_writer *w, const char *p, size_t len)
+{
+	/* spans larger than the staging buffer, e.g. verbatim subtrees */
+	if ((w->sink != SINK_BUF) && (len > w->size)) {
+		if (json_writer_flush(w))
+			return -1;
+		return writer_out(w, p, len);
+	}
+
+	if (writer_reserve(w, len))
+		return -1;
+	memcpy(w->buf + w->len, p, len);
+	w->len += len;
+
+	return 0;
+}
+
+static int writer_newline(struct json_writer *w, size_t depth)
+{
+	if (writer_reserve(w, depth + 1))
+		return -1;
+	w->buf[w->len++] = '\n';
+	memset(w->buf + w->len, '\t', depth);
+	w->len += depth;
+
+	return 0;
+}
+
+/* ',' and indentation in front of the next member or element */
+static int writer_next(struct json_writer *w)
+{
+	unsigned char *item = &w->items[w->depth - 1];
+
+	if ((*item & ITEM_WRITTEN) && writer_put(w, ",", 1))
+		return -1;
+	*item |= ITEM_WRITTEN;
+
+	if (w->flags & JSON_WRITE_PRETTY)
+		return writer_newline(w, w->depth);
+
+	return 0;
+}
+
+/* separator and indentation in front of a value */
+static int writer_sep(struct json_writer *w)
+{
+	if (w->error)
+		return -1;
+
+	if (w->after_name) {
+		w->after_name = 0;
+		return 0;
+	}
+
+	if (w->depth == 0) {
+		if (w->started && writer_put(w, "\n", 1))
+			return -1;
+		w->started = 1;
+		return 0;
+	}
+
+	if (w->items[w->depth - 1] & ITEM_OBJECT) {
+		json_error_set(JSON_ERR_ARG,
+			"a value inside an object needs a name", NULL);
+		return -1;
+	}
+
+	return writer_next(w);
+}
+
+/* separator and indentation in front of a name */
+static int writer_name_sep(struct json_writer *w)
+{
+	if (w->error)
+		return -1;
+
+	if ((w->depth == 0) || w->after_name ||
+		!(w->items[w->depth - 1] & ITEM_OBJECT)) {
+		json_error_set(JSON_ERR_ARG,
+			"a name is only valid inside an object", NULL);
+		return -1;
+	}
+
+	return writer_next(w);
+}
+
+static int writer_begin(struct json_writer *w, char c)
+{
+	unsigned char *n;
+	size_t size;
+
+	if (writer_sep(w) || writer_put(w, &c, 1))
+		return -1;
+
+	if (w->depth == w->items_size) {
+		size = w->items_size ? w->items_size * 2 : 32;
+		n = (unsigned char *)realloc(w->items, size);
+		if (!n) {
+			json_error_sys(JSON_ERR_NOMEM, "realloc writer stack error");
+			w->error = 1;
+			return -1;
+		}
+		w->items = n;
+		w->items_size = size;
+	}
+	w->items[w->depth++] = (c == '{') ? ITEM_OBJECT : 0;
+
+	return 0;
+}
+
+static int writer_end(struct json_writer *w, char c)
+{
+	int object = (c == '}');
+
+	if (w->error)
+		return -1;
+
+	/* the container open at this depth must be of the same kind */
+	if ((w->depth == 0) || w->after_name ||
+		(!(w->items[w->depth - 1] & ITEM_OBJECT) != !object)) {
+		json_error_set(JSON_ERR_ARG, object ?
+			"'}' does not close an object" :
+			"']' does not close an array", NULL);
+		return -1;
+	}
+
+	w->depth--;
+	if ((w->flags & JSON_WRITE_PRETTY) &&
+		(w->items[w->depth] & ITEM_WRITTEN) &&
+		writer_newline(w, w->depth))
+		return -1;
+
+	return writer_put(w, &c, 1);
+}
+
+int json_write_object_begin(struct json_writer *w)
+{
+	return w ? writer_begin(w, '{') : -1;
+}
+
+int json_write_object_end(struct json_writer *w)
+{
+	return w ? writer_end(w, '}') : -1;
+}
+
+int json_write_array_begin(struct json_writer *w)
+{
+	return w ? writer_begin(w, '[') : -1;
+}
+
+int json_write_array_end(struct json_writer *w)
+{
+	return w ? writer_end(w, ']') : -1;
+}
+
+/* 'str' quoted and escaped, runs without escapes are copied in one go */
+static int writer_escape(struct json_writer *w, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *end = str + len;
+	const char *q;
+	char e[6];
+	size_t n;
+	unsigned char c;
+
+	if (writer_put(w, "\"", 1))
+		return -1;
+
+	while (str < end) {
+		q = json_scan_find_escape(str, end);
+		if ((q > str) && writer_put(w, str, q - str))
+			return -1;
+		if (q == end)
+			break;
+
+		c = (unsigned char)*q;
+		e[0] = '\\';
+		n = 2;
+		switch (c) {
+		case '"':
+		case '\\':
+			e[1] = c;
+			break;
+		case '\b':
+			e[1] = 'b';
+			break;
+		case '\f':
+			e[1] = 'f';
+			break;
+		case '\n':
+			e[1] = 'n';
+			break;
+		case '\r':
+			e[1] = 'r';
+			break;
+		case '\t':
+			e[1] = 't';
+			break;
+		default:
+			e[1] = 'u';
+			e[2] = '0';
+			e[3] = '0';
+			e[4] = hex[c >> 4];
+			e[5] = hex[c & 0xf];
+			n = 6;
+			break;
+		}
+		if (writer_put(w, e, n))
+			return -1;
+		str = q + 1;
+	}
+
+	return writer_put(w, "\"", 1);
+}
+
+static int writer_colon(struct json_writer *w)
+{
+	if (w->flags & JSON_WRITE_PRETTY) {
+		if (writer_put(w, ": ", 2))
+			return -1;
+	} else if (writer_put(w, ":", 1)) {
+		return -1;
+	}
+	w->after_name = 1;
+
+	return 0;
+}
+
+int json_write_name(struct json_writer *w, const char *name, size_t len)
+{
+	if (!w || !name)
+		return -1;
+
+	if (writer_name_sep(w) || writer_escape(w, name, len))
+		return -1;
+
+	return writer_colon(w);
+}
+
+int json_write_string(struct json_writer *w, const char *str, size_t len)
+{
+	if (!w || (!str && len))
+		return -1;
+
+	if (writer_sep(w))
+		return -1;
+
+	return writer_escape(w, str, len);
+}
+
+static const char digits2[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233"
+	"34353637383940414243444546474849505152535455565758596061626364656667"
+	"6869707172737475767778798081828384858687888990919293949596979899";
+
+/* decimal digits of 'v' at the end of 'end', two at a time */
+static char *format_u64(char *end, uint64_t v)
+{
+	char *p = end;
+	unsigned int i;
+
+	while (v >= 100) {
+		i = (unsigned int)(v % 100) * 2;
+		v /= 100;
+		*--p = digits2[i + 1];
+		*--p = digits2[i];
+	}
+	if (v >= 10) {
+		i = (unsigned int)v * 2;
+		*--p = digits2[i + 1];
+		*--p = digits2[i];
+	} else {
+		*--p = (char)('0' + v);
+	}
+
+	return p;
+}
+
+int json_write_uint64(struct json_writer *w, uint64_t val)
+{
+	char num[24];
+	char *p;
+
+	if (!w || writer_sep(w))
+		return -1;
+
+	p = format_u64(num + sizeof(num), val);
+
+	return writer_put(w, p, num + sizeof(num) - p);
+}
+
+int json_write_int64(struct json_writer *w, int64_t val)
+{
+	char num[24];
+	char *p;
+
+	if (!w || writer_sep(w))
+		return -1;
+
+	p = format_u64(num + sizeof(num), (val < 0) ? 0 - (uint64_t)val :
+		(uint64_t)val);
+	if (val < 0)
+		*--p = '-';
+
+	return writer_put(w, p, num + sizeof(num) - p);
+}
+
+/*
+ * Doubles are printed with Grisu2 (Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately", PLDI 2010): the digits read back to the
+ * same value and are the shortest ones in nearly all cases. Only integer
+ * arithmetic is used, the output never depends on the locale. A number
+ * is kept as a 64-bit significand 'f' and a binary exponent 'e'.
+ */
+struct grisu_fp {
+	uint64_t f;
+	int e;
+};
+
+#define GRISU_HIDDEN_BIT	((uint64_t)1 << 52)
+#define GRISU_SIGNIFICAND	(GRISU_HIDDEN_BIT - 1)
+#define GRISU_EXP_BIAS		(0x3ff + 52)
+
+/* 10^k for k = -348, -340, ..., 340, rounded to 64 bits */
+static const uint64_t grisu_pow_f[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+	0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+	0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+	0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+	0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+	0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+	0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+	0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+	0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+	0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+	0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+	0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+	0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+	0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+	0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+	0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+	0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+	0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+	0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+	0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+	0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+	0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t grisu_pow_e[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t grisu_pow10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL,
+	10000000000000000000ULL
+};
+
+/* rounded product, the high 64 bits of the 128-bit one */
+static struct grisu_fp grisu_mul(struct grisu_fp a, struct grisu_fp b)
+{
+	unsigned __int128 p = (unsigned __int128)a.f * b.f;
+	struct grisu_fp r;
+
+	r.f = (uint64_t)(p >> 64);
+	if ((uint64_t)p & ((uint64_t)1 << 63))
+		r.f++;
+	r.e = a.e + b.e + 64;
+
+	return r;
+}
+
+static struct grisu_fp grisu_normalize(struct grisu_fp v)
+{
+	int s = __builtin_clzll(v.f);
+
+	v.f <<= s;
+	v.e -= s;
+
+	return v;
+}
+
+/* the halfway points to the neighbouring doubles, 'plus' is normalized */
+static void grisu_boundaries(struct grisu_fp v, struct grisu_fp *minus,
+	struct grisu_fp *plus)
+{
+	struct grisu_fp p, m;
+
+	p.f = (v.f << 1) + 1;
+	p.e = v.e - 1;
+	p = grisu_normalize(p);
+
+	/* the lower neighbour is closer at a power of two */
+	if (v.f == GRISU_HIDDEN_BIT) {
+		m.f = (v.f << 2) - 1;
+		m.e = v.e - 2;
+	} else {
+		m.f = (v.f << 1) - 1;
+		m.e = v.e - 1;
+	}
+	m.f <<= m.e - p.e;
+	m.e = p.e;
+
+	*minus = m;
+	*plus = p;
+}
+
+/* a cached 10^-k that brings 'e' into [-60, -32], '*k' is set */
+static struct grisu_fp grisu_cached_pow(int e, int *k)
+{
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int ik = (int)dk;
+	unsigned int i;
+	struct grisu_fp c;
+
+	if (dk - ik > 0.0)
+		ik++;
+	i = (unsigned int)((ik >> 3) + 1);
+	*k = -(-348 + (int)(i << 3));
+	c.f = grisu_pow_f[i];
+	c.e = grisu_pow_e[i];
+
+	return c;
+}
+
+static int grisu_count_digits(uint32_t n)
+{
+	int d = 1;
+
+	while ((d < 10) && (n >= grisu_pow10[d]))
+		d++;
+
+	return d;
+}
+
+/* moves the last digit towards 'w' while it stays in the interval */
+static void grisu_round(char *buf, int len, uint64_t delta, uint64_t rest,
+	uint64_t ten_kappa, uint64_t wp_w)
+{
+	while ((rest < wp_w) && (delta - rest >= ten_kappa) &&
+		((rest + ten_kappa < wp_w) ||
+		(wp_w - rest > rest + ten_kappa - wp_w))) {
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+static int grisu_digits(struct grisu_fp w, struct grisu_fp mp, uint64_t delta,
+	char *buf, int *k)
+{
+	int shift = -mp.e;
+	uint64_t one = (uint64_t)1 << shift;
+	uint64_t wp_w = mp.f - w.f;
+	uint32_t p1 = (uint32_t)(mp.f >> shift);
+	uint64_t p2 = mp.f & (one - 1);
+	int kappa = grisu_count_digits(p1);
+	int len = 0;
+	uint64_t rest;
+	uint32_t d;
+
+	while (kappa > 0) {
+		d = p1 / (uint32_t)grisu_pow10[kappa - 1];
+		p1 %= (uint32_t)grisu_pow10[kappa - 1];
+		if (d || len)
+			buf[len++] = (char)('0' + d);
+		kappa--;
+		rest = ((uint64_t)p1 << shift) + p2;
+		if (rest <= delta) {
+			*k += kappa;
+			grisu_round(buf, len, delta, rest,
+				grisu_pow10[kappa] << shift, wp_w);
+			return len;
+		}
+	}
+
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+		d = (uint32_t)(p2 >> shift);
+		if (d || len)
+			buf[len++] = (char)('0' + d);
+		p2 &= one - 1;
+		kappa--;
+		if (p2 < delta) {
+			*k += kappa;
+			grisu_round(buf, len, delta, p2, one,
+				(-kappa < 20) ? wp_w * grisu_pow10[-kappa] : 0);
+			return len;
+		}
+	}
+}
+
+/* digits of a finite 'val' > 0, which is 'buf' * 10^'*k' */
+static int grisu2(double val, char *buf, int *k)
+{
+	struct grisu_fp v, w, mp, mm, c;
+	uint64_t bits;
+	int be;
+
+	memcpy(&bits, &val, sizeof(bits));
+	be = (int)((bits >> 52) & 0x7ff);
+	v.f = bits & GRISU_SIGNIFICAND;
+	if (be) {
+		v.f += GRISU_HIDDEN_BIT;
+		v.e = be - GRISU_EXP_BIAS;
+	} else {
+		v.e = 1 - GRISU_EXP_BIAS;
+	}
+
+	grisu_boundaries(v, &mm, &mp);
+	c = grisu_cached_pow(mp.e, k);
+	w = grisu_mul(grisu_normalize(v), c);
+	mp = grisu_mul(mp, c);
+	mm = grisu_mul(mm, c);
+	mm.f++;
+	mp.f--;
+
+	return grisu_digits(w, mp, mp.f - mm.f, buf, k);
+}
+
+/*
+ * 'len' digits times 10^k laid out like JavaScript does: plain notation
+ * for 1e-6 <= |x| < 1e21, else one digit, a fraction and an exponent.
+ * 'out' has room for 32 bytes.
+ */
+static int format_digits(char *out, const char *digits, int len, int k)
+{
+	int point = len + k;	/* digits before the decimal point */
+	char *p = out;
+	int e, i;
+
+	if ((point >= 1) && (point <= 21)) {
+		if (k >= 0) {
+			memcpy(p, digits, len);
+			memset(p + len, '0', k);
+			return len + k;
+		}
+		memcpy(p, digits, point);
+		p[point] = '.';
+		memcpy(p + point + 1, digits + point, len - point);
+		return len + 1;
+	}
+
+	if ((point <= 0) && (point > -6)) {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = point; i < 0; i++)
+			*p++ = '0';
+		memcpy(p, digits, len);
+		return (int)(p - out) + len;
+	}
+
+	*p++ = digits[0];
+	if (len > 1) {
+		*p++ = '.';
+		memcpy(p, digits + 1, len - 1);
+		p += len - 1;
+	}
+	*p++ = 'e';
+	e = point - 1;
+	if (e < 0) {
+		*p++ = '-';
+		e = -e;
+	} else {
+		*p++ = '+';
+	}
+	if (e >= 100)
+		*p++ = (char)('0' + e / 100);
+	if (e >= 10)
+		*p++ = (char)('0' + e / 10 % 10);
+	*p++ = (char)('0' + e % 10);
+
+	return (int)(p - out);
+}
+
+/* integral values below 2^53 go through the integer formatter */
+int json_write_double(struct json_writer *w, double val)
+{
+	char digits[20];
+	char num[32];
+	char *p = num;
+	int len, k;
+
+	if (!w)
+		return -1;
+
+	if (!isfinite(val)) {
+		/* JSON has no NaN or infinity */
+		return json_write_null(w);
+	}
+
+	if ((fabs(val) < 9007199254740992.0) && (val == (double)(int64_t)val) &&
+		!((val == 0) && signbit(val)))
+		return json_write_int64(w, (int64_t)val);
+
+	if (writer_sep(w))
+		return -1;
+
+	if (signbit(val)) {
+		*p++ = '-';
+		val = -val;
+	}
+	if (val == 0) {
+		*p++ = '0';
+		return writer_put(w, num, p - num);
+	}
+
+	len = grisu2(val, digits, &k);
+	len = format_digits(p, digits, len, k);
+
+	return writer_put(w, num, (p - num) + len);
+}
+
+int json_write_bool(struct json_writer *w, int val)
+{
+	return json_write_raw(w, val ? "true" : "false", val ? 4 : 5);
+}
+
+int json_write_null(struct json_writer *w)
+{
+	return json_write_raw(w, "null", 4);
+}
+
+int json_write_raw(struct json_writer *w, const char *p, size_t len)
+{
+	if (!w || !p || writer_sep(w))
+		return -1;
+
+	return writer_put(w, p, len);
+}
+
+/*
+ * Names and strings of a tree are still encoded as in the input. With
+ * JSON_WRITE_VERBATIM only the containers changed by the mutation API are
+ * laid out again, everything else is copied from the input in one piece.
+ */
+int json_write_data(struct json_writer *w, json_data *d)
+{
+	json_data *p;
+	int ret;
+
+	if (!w || !d)
+		return -1;
+
+	if (((d->type != OBJECT) && (d->type != ARRAY)) ||
+		((w->flags & JSON_WRITE_VERBATIM) && !d->dirty))
+		return json_write_raw(w, d->value.p, d->value.len);
+
+	if (json_data_get_count(d) < 0)
+		return -1;
+
+	ret = (d->type == OBJECT) ? json_write_object_begin(w) :
+		json_write_array_begin(w);
+	TAILQ_FOREACH(p, &d->head, next) {
+		if (ret)
+			return -1;
+		if (d->type == OBJECT) {
+			if (writer_name_sep(w) ||
+				writer_put(w, p->name.p, p->name.len) ||
+				writer_colon(w))
+				return -1;
+		}
+		ret = json_write_data(w, p);
+	}
+	if (ret)
+		return -1;
+
+	return (d->type == OBJECT) ? json_write_object_end(w) :
+		json_write_array_end(w);
+}
+
+/* encode one value with 'fn' into a small private buffer and set it */
+static int data_set(json_data *d, const char *name,
+	int (*fn)(struct json_writer *, const void *), const void *val)
+{
+	struct json_writer w;
+	int ret = -1;
+
+	memset(&w, 0, sizeof(w));
+	w.sink = SINK_BUF;
+	w.fd = -1;
+	w.size = 64;
+	w.buf = (char *)malloc(w.size);
+	if (!w.buf) {
+		json_error_sys(JSON_ERR_NOMEM, "malloc writer buffer error");
+		return -1;
+	}
+
+	if (!fn(&w, val))
+		ret = json_data_set_raw(d, name, w.buf, w.len);
+	free(w.buf);
+
+	return ret;
+}
+
+struct set_string {
+	const char *str;
+	size_t len;
+};
+
+static int set_string(struct json_writer *w, const void *val)
+{
+	const struct set_string *s = (const struct set_string *)val;
+
+	return json_write_string(w, s->str, s->len);
+}
+
+static int set_int64(struct json_writer *w, const void *val)
+{
+	return json_write_int64(w, *(const int64_t *)val);
+}
+
+static int set_uint64(struct json_writer *w, const void *val)
+{
+	return json_write_uint64(w, *(const uint64_t *)val);
+}
+
+static int set_double(struct json_writer *w, const void *val)
+{
+	return json_write_double(w, *(const double *)val);
+}
+
+static int set_bool(struct json_writer *w, const void *val)
+{
+	return json_write_bool(w, *(const int *)val);
+}
+
+int json_data_set_string(json_data *d, const char *name, const char *str,
+	size_t len)
+{
+	struct set_string s = { str, len };
+
+	return data_set(d, name, set_string, &s);
+}
+
+int json_data_set_int64(json_data *d, const char *name, int64_t val)
+{
+	return data_set(d, name, set_int64, &val);
+}
+
+int json_data_set_uint64(json_data *d, const char *name, uint64_t val)
+{
+	return data_set(d, name, set_uint64, &val);
+}
+
+int json_data_set_double(json_data *d, const char *name, double val)
+{
+	return data_set(d, name, set_double, &val);
+}
+
+int json_data_set_bool(json_data *d, const char *name, int val)
+{
+	return data_set(d, name, set_bool, &val);
+}
+
+const char *json_writer_buf(struct json_writer *w, size_t *len)
+{
+	if (!w || (w->sink != SINK_BUF)) {
+		json_error_set(JSON_ERR_ARG, "writer has no buffer", NULL);
+		return NULL;
+	}
+
+	if (len)
+		*len = w->len;
+
+	return w->buf;
+}
+
+void json_writer_free(struct json_writer *w)
+{
+	if (w) {
+		if (w->sink != SINK_BUF)
+			json_writer_flush(w);
+		if (w->items)
+			free(w->items);
+		free(w->buf);
+		free(w);
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef __JSON_WRITE_H__
+#define __JSON_WRITE_H__
+
+#include "json.h"
+
+/*
+ * Serializer. A writer sends its output to a growable buffer, a file
+ * descriptor or a callback and takes care of commas and indentation, so
+ * values can be written one after the other, or a whole json_data tree at
+ * once with json_write_data(). A name outside an object, a value without
+ * its name inside one, or an end that does not match the open container
+ * fails with JSON_ERR_ARG and writes nothing.
+ */
+enum json_write_flags {
+	JSON_WRITE_PRETTY = 1 << 0,	/* one member per line, tab indented */
+	JSON_WRITE_VERBATIM = 1 << 1,	/* copy unchanged subtrees as they are */
+};
+
+/* returns non-zero to stop the writer */
+typedef int (*json_write_cb)(void *arg, const char *p, size_t len);
+
+struct json_writer;
+
+struct json_writer *json_writer_new_buf(unsigned int flags);
+struct json_writer *json_writer_new_fd(int fd, unsigned int flags);
+struct json_writer *json_writer_new_cb(json_write_cb cb, void *arg,
+	unsigned int flags);
+/* output of a buffer writer, valid until the next write or the free */
+const char *json_writer_buf(struct json_writer *w, size_t *len);
+int json_writer_flush(struct json_writer *w);
+void json_writer_free(struct json_writer *w);
+
+int json_write_object_begin(struct json_writer *w);
+int json_write_object_end(struct json_writer *w);
+int json_write_array_begin(struct json_writer *w);
+int json_write_array_end(struct json_writer *w);
+int json_write_name(struct json_writer *w, const char *name, size_t len);
+int json_write_string(struct json_writer *w, const char *str, size_t len);
+int json_write_int64(struct json_writer *w, int64_t val);
+int json_write_uint64(struct json_writer *w, uint64_t val);
+int json_write_double(struct json_writer *w, double val);
+int json_write_bool(struct json_writer *w, int val);
+int json_write_null(struct json_writer *w);
+/* an already encoded value, copied as is */
+int json_write_raw(struct json_writer *w, const char *p, size_t len);
+int json_write_data(struct json_writer *w, json_data *d);
+
+/* json_data_set_raw() with the value encoded from a C type */
+int json_data_set_string(json_data *obj, const char *name, const char *str,
+	size_t len);
+int json_data_set_int64(json_data *obj, const char *name, int64_t val);
+int json_data_set_uint64(json_data *obj, const char *name, uint64_t val);
+int json_data_set_double(json_data *obj, const char *name, double val);
+int json_data_set_bool(json_data *obj, const char *name, int val);
+
+#endif /* __JSON_WRITE_H__ */
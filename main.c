@@ -2,24 +2,51 @@
 #include <inttypes.h>
 
 #include "json.h"
+#include "json_path.h"
+#include "json_stats.h"
+
+static void print_error(void)
+{
+	const struct json_error *err = json_last_error();
+
+	if (err->has_pos)
+		printf("%s at line %zu column %zu\n", err->msg, err->line,
+			err->column);
+	else if (err->sys)
+		printf("%s: %s\n", err->msg, strerror(err->sys));
+	else
+		printf("%s\n", err->msg);
+}
 
 int main(int argc, char *argv[])
 {
 	struct option longopts[] = {
 		{"file", required_argument, 0, 'f'},
 		{"string", required_argument, 0, 's'},
+		{"index", no_argument, 0, 'i'},
+		{"arena", no_argument, 0, 'a'},
+		{"mmap", no_argument, 0, 'm'},
+		{"utf8", no_argument, 0, 'u'},
+		{"parallel", no_argument, 0, 'P'},
+		{"path", required_argument, 0, 'p'},
+		{"stats", no_argument, 0, 'S'},
 		{"help", no_argument, 0, 'h'},
 		{0, 0, 0, 0}
 	};
 	const char *file = "test.json";
 	const char *str = NULL;
+	const char *expr = NULL;
+	struct json_path *path;
+	struct json_stats st;
+	int stats = 0;
 	json_data *d, *e, *g, *p;
 	int help = 0;
+	unsigned int flags = 0;
 	int i, ret;
 	unsigned long val;
 	char sval[64];
 
-	while ((ret = getopt_long(argc, argv, "f:s:h", longopts, NULL)) != -1) {
+	while ((ret = getopt_long(argc, argv, "f:s:iamuPp:Sh", longopts, NULL)) != -1) {
 		if (optarg && (*optarg == '='))
 			optarg++;
 		switch (ret) {
@@ -29,6 +56,27 @@ int main(int argc, char *argv[])
 		case 's':
 			str = optarg;
 			break;
+		case 'i':
+			flags |= JSON_PARSE_INDEX;
+			break;
+		case 'a':
+			flags |= JSON_PARSE_ARENA;
+			break;
+		case 'm':
+			flags |= JSON_PARSE_MMAP;
+			break;
+		case 'u':
+			flags |= JSON_PARSE_UTF8;
+			break;
+		case 'P':
+			flags |= JSON_PARSE_PARALLEL;
+			break;
+		case 'p':
+			expr = optarg;
+			break;
+		case 'S':
+			stats = 1;
+			break;
 		case 'h':
 			help = 1;
 			break;
@@ -45,24 +93,46 @@ int main(int argc, char *argv[])
 		printf("Options:\n");
 		printf("\t--file,-f\t[FILE]\n");
 		printf("\t--string,-s\t[STR]\n");
+		printf("\t--index,-i\n");
+		printf("\t--arena,-a\n");
+		printf("\t--mmap,-m\n");
+		printf("\t--utf8,-u\n");
+		printf("\t--parallel,-P\n");
+		printf("\t--path,-p\t[PATH]\n");
+		printf("\t--stats,-S\n");
 		return 0;
 	}
 
 	if (str) {
-		d = json_data_from_string(str);
+		d = json_data_from_string_ex(str, flags);
 		if (!d) {
 			printf("create json data from string failed\n");
+			print_error();
 			return -1;
 		}
 	} else {
-		d = json_data_from_file(file);
+		d = json_data_from_file_ex(file, flags);
 		if (!d) {
 			printf("create json data from file '%s' failed\n", file);
+			print_error();
 			return -1;
 		}
 	}
 
-	if (!strcmp(file, "test.json")) {
+	if (expr) {
+		path = json_path_compile(expr);
+		if (!path) {
+			printf("bad path '%s'\n", expr);
+			print_error();
+		} else {
+			e = json_path_get(path, d);
+			if (e)
+				print_buf(&e->value);
+			else
+				printf("'%s' not found\n", expr);
+			json_path_free(path);
+		}
+	} else if (!strcmp(file, "test.json")) {
 		e = json_data_get_by_name(d, "version");
 		if (!e) {
 			printf("version not found\n");
@@ -167,5 +237,19 @@ int main(int argc, char *argv[])
 	}
 	json_data_free(d);
 
+	if (stats) {
+		if (json_stats_get(&st)) {
+			printf("stats are not built in, rebuild with STATS=1\n");
+		} else {
+			printf("bytes scanned: %"PRIu64"\n", st.bytes_scanned);
+			printf("nodes: %"PRIu64"\n", st.nodes);
+			printf("materializations: %"PRIu64"\n", st.materializations);
+			printf("lookups: %"PRIu64"\n", st.lookups);
+			printf("lookup probes: %"PRIu64"\n", st.lookup_probes);
+			printf("conversion failures: %"PRIu64"\n",
+				st.conversion_failures);
+		}
+	}
+
 	return 0;
 }
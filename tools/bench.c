@@ -0,0 +1,601 @@
+/*
+ * Throughput and latency of the parser on a generated corpus. The corpus
+ * is written once into a directory and reused by later runs, so numbers
+ * from different builds can be compared on the same input.
+ *
+ *	make bench
+ *	./json_bench -d DIR -s MB -t SECONDS [-g]
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../json.h"
+#include "../json_batch.h"
+#include "../json_cursor.h"
+#include "../json_path.h"
+
+/* every allocation of the library goes through these, see bench_allocs() */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+/* counted from the threads of JSON_PARSE_PARALLEL and json_batch too */
+static size_t nallocs;
+
+void *malloc(size_t size)
+{
+	__atomic_fetch_add(&nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	__atomic_fetch_add(&nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	__atomic_fetch_add(&nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(p, size);
+}
+
+void free(void *p)
+{
+	__libc_free(p);
+}
+
+struct corpus {
+	const char *name;
+	void (*gen)(FILE *f, size_t size);
+	char *buf;
+	size_t len;
+};
+
+static unsigned int rnd_state = 1;
+
+static unsigned int rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return rnd_state >> 8;
+}
+
+/* members like tcam.json: "N":{"key0":..,..,"rst1":..} */
+#define FLAT_MEMBER	"{\"key0\":%u,\"key1\":%u,\"msk0\":%u,\"msk1\":%u," \
+			"\"rst0\":%u,\"rst1\":%u}"
+
+static void gen_flat(FILE *f, size_t size)
+{
+	long start = ftell(f);
+	unsigned int i;
+
+	fputc('{', f);
+	for (i = 0; (size_t)(ftell(f) - start) < size; i++) {
+		fprintf(f, "%s\"%u\":" FLAT_MEMBER, i ? "," : "", i,
+			rnd() % 10000, rnd() % 10000, rnd() % 10000,
+			rnd() % 10000, rnd() % 10000, rnd() % 10000);
+	}
+	fputs("}\n", f);
+}
+
+/* objects and arrays nested 64 deep, repeated */
+static void gen_deep(FILE *f, size_t size)
+{
+	long start = ftell(f);
+	int i, depth = 64;
+
+	fputc('[', f);
+	while ((size_t)(ftell(f) - start) < size) {
+		for (i = 0; i < depth; i++)
+			fputs((i & 1) ? "[" : "{\"a\":", f);
+		fprintf(f, "%u", rnd() % 100);
+		for (i = depth - 1; i >= 0; i--)
+			fputs((i & 1) ? "]" : "}", f);
+		fputc(',', f);
+	}
+	fputs("0]\n", f);
+}
+
+static void gen_array(FILE *f, size_t size)
+{
+	long start = ftell(f);
+	unsigned int i;
+
+	fputc('[', f);
+	for (i = 0; (size_t)(ftell(f) - start) < size; i++)
+		fprintf(f, "%s%u", i ? "," : "", rnd());
+	fputs("]\n", f);
+}
+
+static void gen_string(FILE *f, size_t size)
+{
+	static const char *words[] = {
+		"flow", "match", "queue", "\\\"quoted\\\"", "tab\\there",
+		"caf\\u00e9", "line\\n", "\\ud83d\\ude00", "path\\/to",
+	};
+	long start = ftell(f);
+	unsigned int i, j, n;
+
+	fputc('[', f);
+	for (i = 0; (size_t)(ftell(f) - start) < size; i++) {
+		fputs(i ? ",\"" : "\"", f);
+		n = 4 + rnd() % 16;
+		for (j = 0; j < n; j++)
+			fprintf(f, "%s%s", j ? " " : "",
+				words[rnd() % (sizeof(words) / sizeof(words[0]))]);
+		fputc('\"', f);
+	}
+	fputs("]\n", f);
+}
+
+static void gen_number(FILE *f, size_t size)
+{
+	long start = ftell(f);
+	unsigned int i;
+
+	fputc('[', f);
+	for (i = 0; (size_t)(ftell(f) - start) < size; i++)
+		fprintf(f, "%s{\"x\":%.17g,\"y\":%d,\"z\":%ue%d}", i ? "," : "",
+			(double)rnd() / 7.0, -(int)(rnd() % 100000),
+			rnd() % 1000, (int)(rnd() % 40) - 20);
+	fputs("]\n", f);
+}
+
+static void gen_ndjson(FILE *f, size_t size)
+{
+	long start = ftell(f);
+	unsigned int i;
+
+	for (i = 0; (size_t)(ftell(f) - start) < size; i++)
+		fprintf(f, "{\"id\":%u,\"name\":\"rec%u\",\"tags\":[%u,%u,%u],"
+			"\"ok\":true}\n", i, rnd(), rnd() % 10, rnd() % 10,
+			rnd() % 10);
+}
+
+static struct corpus corpora[] = {
+	{ "flat", gen_flat, NULL, 0 },
+	{ "deep", gen_deep, NULL, 0 },
+	{ "array", gen_array, NULL, 0 },
+	{ "string", gen_string, NULL, 0 },
+	{ "number", gen_number, NULL, 0 },
+	{ "ndjson", gen_ndjson, NULL, 0 },
+};
+
+#define NCORPORA	(sizeof(corpora) / sizeof(corpora[0]))
+
+static char *corpus_path(const char *dir, struct corpus *c)
+{
+	static char path[4096];
+
+	snprintf(path, sizeof(path), "%s/%s.json", dir, c->name);
+	return path;
+}
+
+static int corpus_load(const char *dir, struct corpus *c, size_t size,
+	int regen)
+{
+	const char *path = corpus_path(dir, c);
+	struct stat st;
+	FILE *f;
+
+	if (regen || stat(path, &st)) {
+		f = fopen(path, "w");
+		if (!f) {
+			perror("fopen error");
+			return -1;
+		}
+		c->gen(f, size);
+		fclose(f);
+	}
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror("fopen error");
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	c->len = ftell(f);
+	rewind(f);
+	c->buf = (char *)malloc(c->len + 1);
+	if (!c->buf || (fread(c->buf, 1, c->len, f) != c->len)) {
+		printf("read '%s' failed\n", path);
+		fclose(f);
+		return -1;
+	}
+	c->buf[c->len] = '\0';
+	fclose(f);
+
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double min_time = 0.5;
+
+/* run 'fn' until 'min_time' has passed, returns seconds per run */
+static double bench_run(int (*fn)(void *), void *arg)
+{
+	double start = now(), t;
+	size_t n = 0;
+
+	do {
+		if (fn(arg))
+			return -1;
+		n++;
+		t = now() - start;
+	} while (t < min_time);
+
+	return t / n;
+}
+
+/* materialize every node, like a consumer reading the whole document */
+static void walk(json_data *d)
+{
+	json_data *p;
+
+	if ((d->type != OBJECT) && (d->type != ARRAY))
+		return;
+	if (json_data_get_count(d) < 0)
+		return;
+	TAILQ_FOREACH(p, &d->head, next)
+		walk(p);
+}
+
+struct parse_arg {
+	struct corpus *c;
+	const char *path;
+	unsigned int flags;
+	int walk;
+};
+
+static int bench_string(void *data)
+{
+	struct parse_arg *a = (struct parse_arg *)data;
+	json_data *d;
+
+	d = json_data_from_string_ex(a->c->buf, a->flags);
+	if (!d)
+		return -1;
+	if (a->walk)
+		walk(d);
+	json_data_free(d);
+
+	return 0;
+}
+
+static int bench_file(void *data)
+{
+	struct parse_arg *a = (struct parse_arg *)data;
+	json_data *d;
+
+	d = json_data_from_file_ex(a->path, a->flags);
+	if (!d)
+		return -1;
+	if (a->walk)
+		walk(d);
+	json_data_free(d);
+
+	return 0;
+}
+
+static int bench_batch(void *data)
+{
+	struct parse_arg *a = (struct parse_arg *)data;
+	json_data **docs;
+	size_t n;
+
+	docs = json_batch_parse(a->c->buf, a->c->len, a->flags, 0, &n);
+	if (!docs)
+		return -1;
+	json_batch_free(docs, n);
+
+	return 0;
+}
+
+/* reads two members of every record, like a message router */
+static int bench_cursor(void *data)
+{
+	struct parse_arg *a = (struct parse_arg *)data;
+	const char *p = a->c->buf;
+	const char *end = p + a->c->len;
+	const char *nl;
+	struct json_cursor c;
+	uint64_t id;
+	buf_t ok;
+
+	for (; p < end; p = nl + 1) {
+		nl = memchr(p, '\n', end - p);
+		if (!nl)
+			nl = end;
+		json_cursor_init(&c, p, nl - p);
+		if (json_cursor_enter_object(&c) ||
+			(json_cursor_find_field(&c, "id") <= 0) ||
+			json_cursor_get_uint64(&c, &id) ||
+			(json_cursor_find_field(&c, "ok") <= 0) ||
+			json_cursor_get_raw(&c, &ok, NULL))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void report(struct corpus *c, const char *test, double t)
+{
+	if (t < 0)
+		printf("%-8s %-28s failed\n", c->name, test);
+	else
+		printf("%-8s %-28s %10.1f MB/s\n", c->name, test,
+			c->len / t / (1 << 20));
+}
+
+static size_t bench_allocs(struct parse_arg *a)
+{
+	size_t n = __atomic_load_n(&nallocs, __ATOMIC_RELAXED);
+
+	bench_string(a);
+	return __atomic_load_n(&nallocs, __ATOMIC_RELAXED) - n;
+}
+
+static void bench_parse(const char *dir, struct corpus *c)
+{
+	static const struct {
+		const char *name;
+		unsigned int flags;
+	} modes[] = {
+		{ "", 0 },
+		{ "+index", JSON_PARSE_INDEX },
+		{ "+arena", JSON_PARSE_ARENA },
+		{ "+index+arena", JSON_PARSE_INDEX | JSON_PARSE_ARENA },
+		{ "+parallel+arena", JSON_PARSE_PARALLEL | JSON_PARSE_ARENA },
+		{ "+compact", JSON_PARSE_COMPACT },
+	};
+	struct parse_arg a = { c, corpus_path(dir, c), 0, 0 };
+	char test[64];
+	size_t i;
+
+	if (!strcmp(c->name, "ndjson")) {
+		report(c, "json_batch_parse", bench_run(bench_batch, &a));
+		report(c, "cursor id+ok", bench_run(bench_cursor, &a));
+		return;
+	}
+
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		a.flags = modes[i].flags;
+		a.walk = 0;
+		snprintf(test, sizeof(test), "from_string%s", modes[i].name);
+		report(c, test, bench_run(bench_string, &a));
+		snprintf(test, sizeof(test), "from_file%s", modes[i].name);
+		report(c, test, bench_run(bench_file, &a));
+		a.walk = 1;
+		snprintf(test, sizeof(test), "from_string%s+walk", modes[i].name);
+		report(c, test, bench_run(bench_string, &a));
+		printf("%-8s %-28s %10zu allocs/doc\n", c->name, test,
+			bench_allocs(&a));
+	}
+}
+
+/* a few values out of a large document, with and without a projection */
+struct proj_arg {
+	struct corpus *c;
+	const char *const *exprs;
+	size_t n;
+	int proj;		/* 1: projection, 2: JSON_PARSE_COMPACT */
+};
+
+static int bench_proj_run(void *data)
+{
+	struct proj_arg *a = (struct proj_arg *)data;
+	struct json_path *path;
+	json_data *d;
+	size_t i;
+	int ret = 0;
+
+	if (a->proj == 1)
+		d = json_path_parse(a->c->buf, a->c->len, a->exprs, a->n, 0);
+	else if (a->proj == 2)
+		d = json_data_from_string_ex(a->c->buf, JSON_PARSE_COMPACT);
+	else
+		d = json_data_from_string(a->c->buf);
+	if (!d)
+		return -1;
+	for (i = 0; i < a->n; i++) {
+		path = json_path_compile(a->exprs[i]);
+		if (!json_path_get(path, d))
+			ret = -1;
+		json_path_free(path);
+	}
+	json_data_free(d);
+
+	return ret;
+}
+
+static void bench_proj(struct corpus *c, const char *const *exprs, size_t n)
+{
+	struct proj_arg a = { c, exprs, n, 0 };
+	char test[64];
+
+	snprintf(test, sizeof(test), "from_string+%zu paths", n);
+	report(c, test, bench_run(bench_proj_run, &a));
+	a.proj = 1;
+	snprintf(test, sizeof(test), "path_parse %zu paths", n);
+	report(c, test, bench_run(bench_proj_run, &a));
+	a.proj = 2;
+	snprintf(test, sizeof(test), "from_string+compact+%zu paths", n);
+	report(c, test, bench_run(bench_proj_run, &a));
+}
+
+/* a numeric array decoded element by element, then in one call */
+static void bench_bulk(struct corpus *array)
+{
+	json_data *d;
+	uint64_t *vals;
+	double start, t;
+	size_t n, i, count, runs;
+	int ret = 0;
+
+	d = json_data_from_string(array->buf);
+	if (!d)
+		return;
+	count = json_data_get_count(d);
+	vals = (uint64_t *)malloc(count * sizeof(*vals));
+	if (!vals) {
+		json_data_free(d);
+		return;
+	}
+
+	start = now();
+	runs = 0;
+	do {
+		for (i = 0; i < count; i++)
+			ret |= json_data_to_uint64(json_data_get_by_index(d,
+				(int)i), &vals[i]);
+		runs++;
+		t = now() - start;
+	} while (t < min_time);
+	printf("%-8s %-28s %10.1f ns/elem\n", array->name, "get_by_index+to_uint64",
+		t / (runs * count) * 1e9);
+
+	start = now();
+	runs = 0;
+	do {
+		ret |= json_data_to_uint64_array(d, vals, count, &n);
+		runs++;
+		t = now() - start;
+	} while (t < min_time);
+	printf("%-8s %-28s %10.1f ns/elem\n", array->name, "to_uint64_array",
+		t / (runs * count) * 1e9);
+
+	if (ret)
+		printf("conversion failed\n");
+	free(vals);
+	json_data_free(d);
+}
+
+#define NLOOKUPS	4096
+
+static void bench_lookup(struct corpus *flat, struct corpus *array)
+{
+	static char names[NLOOKUPS][16];
+	static int idx[NLOOKUPS];
+	json_data *d;
+	double start, t;
+	size_t n, i, count;
+	long sink = 0;
+
+	d = json_data_from_string(flat->buf);
+	if (!d)
+		return;
+	count = json_data_get_count(d);
+	for (i = 0; i < NLOOKUPS; i++)
+		snprintf(names[i], sizeof(names[i]), "%zu", rnd() % count);
+	json_data_get_by_name(d, names[0]);	/* build the index first */
+	start = now();
+	n = 0;
+	do {
+		for (i = 0; i < NLOOKUPS; i++)
+			sink += json_data_get_by_name(d, names[i]) != NULL;
+		n += NLOOKUPS;
+		t = now() - start;
+	} while (t < min_time);
+	printf("%-8s %-28s %10.1f ns/op (%zu members)\n", flat->name,
+		"get_by_name", t / n * 1e9, count);
+	json_data_free(d);
+
+	d = json_data_from_string(array->buf);
+	if (!d)
+		return;
+	count = json_data_get_count(d);
+	for (i = 0; i < NLOOKUPS; i++)
+		idx[i] = rnd() % count;
+	json_data_get_by_index(d, 0);
+	start = now();
+	n = 0;
+	do {
+		for (i = 0; i < NLOOKUPS; i++)
+			sink += json_data_get_by_index(d, idx[i]) != NULL;
+		n += NLOOKUPS;
+		t = now() - start;
+	} while (t < min_time);
+	printf("%-8s %-28s %10.1f ns/op (%zu elements)\n", array->name,
+		"get_by_index", t / n * 1e9, count);
+	json_data_free(d);
+
+	if (sink == 0)
+		printf("no lookup succeeded\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *const flat_paths[] = {
+		"7.key0", "100.msk1", "1000.rst1",
+	};
+	static const char *const deep_paths[] = { "[3].a[0].a[0].a" };
+	char tmp[1024];
+	const char *dir = NULL;
+	size_t size = 4;
+	int regen = 0;
+	size_t i;
+	int ret;
+
+	while ((ret = getopt(argc, argv, "d:s:t:gh")) != -1) {
+		switch (ret) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			min_time = strtod(optarg, NULL);
+			break;
+		case 'g':
+			regen = 1;
+			break;
+		default:
+			printf("usage: %s [-d DIR] [-s MB] [-t SECONDS] [-g]\n",
+				argv[0]);
+			return ret == 'h' ? 0 : -1;
+		}
+	}
+
+	/* the corpora are large, they stay out of the source tree */
+	if (!dir) {
+		dir = getenv("TMPDIR");
+		snprintf(tmp, sizeof(tmp), "%s/json_bench_corpus",
+			(dir && *dir) ? dir : "/tmp");
+		dir = tmp;
+	}
+
+	if (mkdir(dir, 0755) && (errno != EEXIST)) {
+		perror("mkdir error");
+		return -1;
+	}
+
+	for (i = 0; i < NCORPORA; i++) {
+		if (corpus_load(dir, &corpora[i], size << 20, regen))
+			return -1;
+	}
+
+	for (i = 0; i < NCORPORA; i++)
+		bench_parse(dir, &corpora[i]);
+	bench_lookup(&corpora[0], &corpora[2]);
+	bench_bulk(&corpora[2]);
+	bench_proj(&corpora[0], flat_paths,
+		sizeof(flat_paths) / sizeof(flat_paths[0]));
+	bench_proj(&corpora[1], deep_paths,
+		sizeof(deep_paths) / sizeof(deep_paths[0]));
+
+	for (i = 0; i < NCORPORA; i++)
+		free(corpora[i].buf);
+
+	return 0;
+}
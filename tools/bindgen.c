@@ -0,0 +1,211 @@
+/*
+ * Prints the C structs and json_bind_field tables matching a sample
+ * document, to be pasted into a program and adjusted by hand: integers
+ * become int64_t, other numbers double, strings char[64], and arrays get
+ * room for as many elements as the sample has. The members of an array of
+ * objects are taken from its first element.
+ */
+#include <ctype.h>
+
+#include "../json.h"
+
+#define BINDGEN_STRING_SIZE	64
+
+struct bindgen_name {
+	char s[128];
+};
+
+static void bindgen_ident(buf_t *name, char *s, size_t size)
+{
+	const char *p = name->p;
+	size_t len = name->len;
+	size_t i, n = 0;
+
+	/* names keep their quotes in json_data */
+	if ((len >= 2) && (p[0] == '\"')) {
+		p++;
+		len -= 2;
+	}
+
+	if (len && isdigit((unsigned char)p[0]) && (n < size - 1))
+		s[n++] = '_';
+	for (i = 0; (i < len) && (n < size - 1); i++)
+		s[n++] = isalnum((unsigned char)p[i]) ? p[i] : '_';
+	s[n] = '\0';
+}
+
+static int bindgen_is_int(json_data *d)
+{
+	const char *p = d->value.p;
+	size_t i, len = d->value.len;
+	int hex = memchr(p, 'x', len) || memchr(p, 'X', len);
+
+	for (i = 0; i < len; i++) {
+		if ((p[i] == '.') || (!hex && ((p[i] == 'e') || (p[i] == 'E'))))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int bindgen_is_number(json_data *d)
+{
+	return d->value.len && strchr("+-.0123456789", d->value.p[0]);
+}
+
+static int bindgen_renamed(buf_t *name, const char *m)
+{
+	size_t len = strlen(m);
+
+	return (name->len != len + 2) || strncmp(name->p + 1, m, len);
+}
+
+static const char *bindgen_macro(json_data *d)
+{
+	if (d->type == ARRAY)
+		return "JSON_BIND_ARRAY_OF";
+	if (d->type == OBJECT)
+		return "JSON_BIND_STRUCT";
+
+	return "JSON_BIND_SCALAR";
+}
+
+static void bindgen_struct(json_data *obj, const char *sname);
+
+/* emits the struct of an object member or array element, if any */
+static json_data *bindgen_nested(json_data *d, const char *sname,
+	const char *mname, struct bindgen_name *n)
+{
+	snprintf(n->s, sizeof(n->s), "%s_%s", sname, mname);
+
+	if ((d->type == ARRAY) && json_data_get_count(d))
+		d = json_data_get_by_index(d, 0);
+	if (d->type != OBJECT)
+		return NULL;
+	bindgen_struct(d, n->s);
+
+	return d;
+}
+
+static void bindgen_struct(json_data *obj, const char *sname)
+{
+	struct bindgen_name n;
+	json_data *d, *e;
+	char m[64];
+
+	if (json_data_get_count(obj) < 0)
+		return;
+
+	TAILQ_FOREACH(d, &obj->head, next) {
+		bindgen_ident(&d->name, m, sizeof(m));
+		bindgen_nested(d, sname, m, &n);
+	}
+
+	printf("struct %s {\n", sname);
+	TAILQ_FOREACH(d, &obj->head, next) {
+		bindgen_ident(&d->name, m, sizeof(m));
+		e = (d->type == ARRAY) ? json_data_get_by_index(d, 0) : d;
+		if (!e) {
+			printf("\t/* '%s' is an empty array */\n", m);
+			continue;
+		}
+
+		if (e->type == OBJECT)
+			printf("\tstruct %s_%s %s", sname, m, m);
+		else if (e->type == STRING)
+			printf("\tchar %s", m);
+		else if (!bindgen_is_number(e)) {
+			printf("\t/* '%s' has no C type */\n", m);
+			continue;
+		} else if (bindgen_is_int(e))
+			printf("\tint64_t %s", m);
+		else
+			printf("\tdouble %s", m);
+
+		if (d->type == ARRAY)
+			printf("[%d]", json_data_get_count(d));
+		if (e->type == STRING)
+			printf("[%d]", BINDGEN_STRING_SIZE);
+		printf(";\n");
+		if (d->type == ARRAY)
+			printf("\tsize_t %s_count;\n", m);
+	}
+	printf("};\n\n");
+
+	/* element descriptors of the arrays */
+	TAILQ_FOREACH(d, &obj->head, next) {
+		if (d->type != ARRAY)
+			continue;
+		e = json_data_get_by_index(d, 0);
+		if (!e)
+			continue;
+		bindgen_ident(&d->name, m, sizeof(m));
+		if (e->type == OBJECT)
+			printf("static const struct json_bind_field %s_%s_elem =\n"
+				"\tJSON_BIND_ELEM_STRUCT(struct %s_%s, %s_%s_fields);\n",
+				sname, m, sname, m, sname, m);
+		else if (e->type == STRING)
+			printf("static const struct json_bind_field %s_%s_elem =\n"
+				"\tJSON_BIND_ELEM(JSON_BIND_STRING, char[%d]);\n",
+				sname, m, BINDGEN_STRING_SIZE);
+		else if (bindgen_is_number(e))
+			printf("static const struct json_bind_field %s_%s_elem =\n"
+				"\tJSON_BIND_ELEM(%s, %s);\n", sname, m,
+				bindgen_is_int(e) ? "JSON_BIND_INT" : "JSON_BIND_DOUBLE",
+				bindgen_is_int(e) ? "int64_t" : "double");
+	}
+
+	printf("static const struct json_bind_field %s_fields[] = {\n", sname);
+	TAILQ_FOREACH(d, &obj->head, next) {
+		bindgen_ident(&d->name, m, sizeof(m));
+		e = (d->type == ARRAY) ? json_data_get_by_index(d, 0) : d;
+		if (!e || ((e->type == MISC) && !bindgen_is_number(e)))
+			continue;
+
+		/* the quoted name is a C string literal as well */
+		if (bindgen_renamed(&d->name, m))
+			printf("\t%s_AS(struct %s, %s, %.*s, ", bindgen_macro(d),
+				sname, m, (int)d->name.len, d->name.p);
+		else
+			printf("\t%s(struct %s, %s, ", bindgen_macro(d), sname, m);
+
+		if (d->type == ARRAY)
+			printf("&%s_%s_elem, %s_count),\n", sname, m, m);
+		else if (d->type == OBJECT)
+			printf("%s_%s_fields),\n", sname, m);
+		else
+			printf("%s),\n", (d->type == STRING) ? "JSON_BIND_STRING" :
+				bindgen_is_int(d) ? "JSON_BIND_INT" : "JSON_BIND_DOUBLE");
+	}
+	printf("\tJSON_BIND_END\n};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *sname = "config";
+	json_data *d;
+
+	if ((argc < 2) || (argc > 3)) {
+		printf("usage: %s FILE [STRUCT]\n", argv[0]);
+		return -1;
+	}
+	if (argc == 3)
+		sname = argv[2];
+
+	d = json_data_from_file(argv[1]);
+	if (!d) {
+		printf("create json data from file '%s' failed\n", argv[1]);
+		return -1;
+	}
+	if (d->type != OBJECT) {
+		printf("json data is not object\n");
+		json_data_free(d);
+		return -1;
+	}
+
+	printf("#include \"json_bind.h\"\n\n");
+	bindgen_struct(d, sname);
+	json_data_free(d);
+
+	return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef __JSON_CHECK_H__
+#define __JSON_CHECK_H__
+
+/*
+ * Shared by the tools/check_*.c programs of "make check": a failed
+ * condition is printed with its line and counted, check_end() reports the
+ * count and gives the exit status.
+ */
+#include <stdio.h>
+
+static int check_bad;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		check_bad++; \
+	} \
+} while (0)
+
+static int check_end(const char *name)
+{
+	printf("%s: %d bad\n", name, check_bad);
+	return check_bad ? -1 : 0;
+}
+
+#endif /* __JSON_CHECK_H__ */
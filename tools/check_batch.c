@@ -0,0 +1,154 @@
+/*
+ * NDJSON batches on several threads: records come back in input order
+ * whatever thread parsed them, blank lines are not records, and a record
+ * that does not parse, trailing data included, is a NULL slot with its
+ * own error.
+ */
+#include "../json_batch.h"
+#include "check.h"
+
+#define CHECK_BATCH_RECORDS	5000
+
+/* record 'i' fails when i % 97 == 13 */
+static int batch_bad(size_t i)
+{
+	return (i % 97) == 13;
+}
+
+/* blank lines every few records, the last record has no newline */
+static char *batch_input(size_t *len)
+{
+	char *s, *p;
+	size_t i;
+
+	s = (char *)malloc(CHECK_BATCH_RECORDS * 64);
+	if (!s)
+		return NULL;
+
+	p = s;
+	for (i = 0; i < CHECK_BATCH_RECORDS; i++) {
+		if (i % 7 == 3)
+			p += sprintf(p, "\n  \t\n");
+		if (batch_bad(i))
+			p += sprintf(p, (i % 2) ? "{\"i\": %zu} {\"i\": 0}" :
+				"[%zu, 1] x", i);
+		else if (i % 2)
+			p += sprintf(p, "  [%zu, {\"x\": []}]\t", i);
+		else
+			p += sprintf(p, "{\"i\": %zu, \"s\": \"a\\nb\"}", i);
+		if (i + 1 < CHECK_BATCH_RECORDS)
+			p += sprintf(p, "\n");
+	}
+	*len = p - s;
+
+	return s;
+}
+
+/* the number in record 'd', either member "i" or element 0 */
+static long batch_num(json_data *d)
+{
+	json_data *v;
+	long n;
+
+	v = json_data_get_by_name(d, "i");
+	if (!v)
+		v = json_data_get_by_index(d, 0);
+	if (json_data_to_long(v, &n))
+		return -1;
+
+	return n;
+}
+
+static void check_docs(const char *s, size_t len, unsigned int flags,
+	int nthreads)
+{
+	json_data **docs;
+	size_t n, i;
+
+	docs = json_batch_parse(s, len, flags, nthreads, &n);
+	CHECK(docs && (n == CHECK_BATCH_RECORDS));
+	if (!docs)
+		return;
+
+	for (i = 0; i < n; i++) {
+		if (batch_bad(i))
+			CHECK(!docs[i]);
+		else
+			CHECK(docs[i] && (batch_num(docs[i]) == (long)i));
+	}
+	json_batch_free(docs, n);
+}
+
+struct batch_seen {
+	char seen[CHECK_BATCH_RECORDS];
+	int bad;
+};
+
+/* every record once, the failed ones with an error inside the record */
+static int batch_cb(void *arg, size_t idx, json_data *d)
+{
+	struct batch_seen *b = (struct batch_seen *)arg;
+	const struct json_error *e;
+
+	if ((idx >= CHECK_BATCH_RECORDS) || b->seen[idx]) {
+		__atomic_add_fetch(&b->bad, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	b->seen[idx] = 1;
+
+	if (!d) {
+		e = json_last_error();
+		if (!batch_bad(idx) || (e->code != JSON_ERR_SYNTAX) ||
+			!e->has_pos || (e->offset == 0) || (e->offset > 64))
+			__atomic_add_fetch(&b->bad, 1, __ATOMIC_RELAXED);
+	} else if (batch_bad(idx) || (batch_num(d) != (long)idx)) {
+		__atomic_add_fetch(&b->bad, 1, __ATOMIC_RELAXED);
+	}
+	json_data_free(d);
+
+	return 0;
+}
+
+static void check_cb(const char *s, size_t len, int nthreads)
+{
+	static struct batch_seen b;
+	size_t i;
+
+	memset(&b, 0, sizeof(b));
+	CHECK(!json_batch_parse_cb(s, len, 0, nthreads, batch_cb, &b));
+	CHECK(b.bad == 0);
+	for (i = 0; i < CHECK_BATCH_RECORDS; i++)
+		CHECK(b.seen[i]);
+}
+
+int main(void)
+{
+	static const unsigned int modes[] = {
+		0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+	};
+	static const int threads[] = { 1, 2, 3, 8 };
+	json_data **docs;
+	size_t len, n, m, t;
+	char *s;
+
+	s = batch_input(&len);
+	if (!s)
+		return -1;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+		for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+			check_docs(s, len, modes[m], threads[t]);
+	for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+		check_cb(s, len, threads[t]);
+	free(s);
+
+	/* blank lines only, and a single record without its newline */
+	docs = json_batch_parse("\n \n\t\n", 5, 0, 2, &n);
+	CHECK(n == 0);
+	json_batch_free(docs, n);
+	docs = json_batch_parse("[1] x", 5, 0, 2, &n);
+	CHECK(docs && (n == 1) && !docs[0]);
+	json_batch_free(docs, n);
+
+	return check_end("check_batch");
+}
@@ -0,0 +1,125 @@
+/*
+ * Struct binding at the limits of every field width: the values that just
+ * fit are stored, the ones past them fail with JSON_ERR_RANGE, strings and
+ * arrays larger than their field with JSON_ERR_SPACE and JSON_ERR_LIMIT.
+ */
+#include "../json_bind.h"
+#include "check.h"
+
+struct bind_in {
+	int8_t x;
+};
+
+struct bind_all {
+	int8_t i8;
+	int16_t i16;
+	int32_t i32;
+	int64_t i64;
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+	float f;
+	double d;
+	char s[4];
+	int8_t a[3];
+	size_t na;
+	struct bind_in in;
+};
+
+static const struct json_bind_field in_fields[] = {
+	JSON_BIND_SCALAR(struct bind_in, x, JSON_BIND_INT),
+	JSON_BIND_END,
+};
+
+static const struct json_bind_field a_elem = JSON_BIND_ELEM(JSON_BIND_INT,
+	int8_t);
+
+static const struct json_bind_field fields[] = {
+	JSON_BIND_SCALAR(struct bind_all, i8, JSON_BIND_INT),
+	JSON_BIND_SCALAR(struct bind_all, i16, JSON_BIND_INT),
+	JSON_BIND_SCALAR(struct bind_all, i32, JSON_BIND_INT),
+	JSON_BIND_SCALAR(struct bind_all, i64, JSON_BIND_INT),
+	JSON_BIND_SCALAR(struct bind_all, u8, JSON_BIND_UINT),
+	JSON_BIND_SCALAR(struct bind_all, u16, JSON_BIND_UINT),
+	JSON_BIND_SCALAR(struct bind_all, u32, JSON_BIND_UINT),
+	JSON_BIND_SCALAR(struct bind_all, u64, JSON_BIND_UINT),
+	JSON_BIND_SCALAR(struct bind_all, f, JSON_BIND_DOUBLE),
+	JSON_BIND_SCALAR(struct bind_all, d, JSON_BIND_DOUBLE),
+	JSON_BIND_SCALAR(struct bind_all, s, JSON_BIND_STRING),
+	JSON_BIND_ARRAY_OF(struct bind_all, a, &a_elem, na),
+	JSON_BIND_STRUCT(struct bind_all, in, in_fields),
+	JSON_BIND_END,
+};
+
+/* the object {"name": value} fails with 'code' */
+static void check_fail(const char *name, const char *value,
+	enum json_error_code code)
+{
+	struct bind_all b;
+	char s[128];
+
+	snprintf(s, sizeof(s), "{\"%s\": %s}", name, value);
+	json_clear_error();
+	CHECK(json_bind_from_string(s, fields, &b) &&
+		(json_last_error()->code == code));
+}
+
+static void check_limits(void)
+{
+	struct bind_all b;
+
+	memset(&b, 0, sizeof(b));
+	CHECK(!json_bind_from_string("{\"i8\": -128, \"i16\": -32768,"
+		" \"i32\": -2147483648, \"i64\": -9223372036854775808,"
+		" \"u8\": 255, \"u16\": 65535, \"u32\": 4294967295,"
+		" \"u64\": 18446744073709551615, \"f\": 3.4e38, \"d\": 1e308,"
+		" \"s\": \"abc\", \"a\": [127, -128, 0], \"in\": {\"x\": 127}}",
+		fields, &b));
+	CHECK((b.i8 == -128) && (b.i16 == -32768) && (b.i32 == INT32_MIN) &&
+		(b.i64 == INT64_MIN));
+	CHECK((b.u8 == 255) && (b.u16 == 65535) && (b.u32 == UINT32_MAX) &&
+		(b.u64 == UINT64_MAX));
+	CHECK((b.f == 3.4e38f) && (b.d == 1e308) && !strcmp(b.s, "abc"));
+	CHECK((b.na == 3) && (b.a[0] == 127) && (b.a[1] == -128) &&
+		(b.in.x == 127));
+
+	CHECK(!json_bind_from_string("{\"i8\": 127, \"i16\": 32767,"
+		" \"i32\": 2147483647, \"i64\": 9223372036854775807, \"u8\": -0}",
+		fields, &b));
+	CHECK((b.i8 == 127) && (b.i16 == 32767) && (b.i32 == INT32_MAX) &&
+		(b.i64 == INT64_MAX) && (b.u8 == 0));
+}
+
+int main(void)
+{
+	check_limits();
+
+	check_fail("i8", "128", JSON_ERR_RANGE);
+	check_fail("i8", "-129", JSON_ERR_RANGE);
+	check_fail("i16", "32768", JSON_ERR_RANGE);
+	check_fail("i16", "-32769", JSON_ERR_RANGE);
+	check_fail("i32", "2147483648", JSON_ERR_RANGE);
+	check_fail("i32", "-2147483649", JSON_ERR_RANGE);
+	check_fail("i64", "9223372036854775808", JSON_ERR_RANGE);
+	check_fail("i64", "-9223372036854775809", JSON_ERR_RANGE);
+	check_fail("u8", "256", JSON_ERR_RANGE);
+	check_fail("u8", "-1", JSON_ERR_RANGE);
+	check_fail("u16", "65536", JSON_ERR_RANGE);
+	check_fail("u32", "4294967296", JSON_ERR_RANGE);
+	check_fail("u64", "18446744073709551616", JSON_ERR_RANGE);
+	check_fail("u64", "-1", JSON_ERR_RANGE);
+	check_fail("f", "3.5e38", JSON_ERR_RANGE);
+	check_fail("in", "{\"x\": 200}", JSON_ERR_RANGE);
+	check_fail("a", "[1, 2, 300]", JSON_ERR_RANGE);
+
+	check_fail("s", "\"abcd\"", JSON_ERR_SPACE);
+	check_fail("a", "[1, 2, 3, 4]", JSON_ERR_LIMIT);
+
+	/* what is not an integer is not a range error */
+	check_fail("i8", "1.5", JSON_ERR_SYNTAX);
+	check_fail("u8", "-x", JSON_ERR_SYNTAX);
+	check_fail("i8", "\"1\"", JSON_ERR_TYPE);
+
+	return check_end("check_bind");
+}
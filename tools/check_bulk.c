@@ -0,0 +1,89 @@
+/*
+ * json_data_to_*_array() on arrays of the input and on arrays added by
+ * mutation, whose text is a copy outside the document buffer. Built with
+ * AddressSanitizer by "make check", reads past either text are caught.
+ */
+#include "../json.h"
+#include "check.h"
+
+#define CHECK_BULK_DOC	(4 << 20)
+
+static const unsigned int modes[] = {
+	0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+};
+
+/* a large object, so that the document ends far from a mutation copy */
+static char *bulk_doc(void)
+{
+	char *s, *p;
+	int i;
+
+	s = (char *)malloc(CHECK_BULK_DOC + 64);
+	if (!s)
+		return NULL;
+
+	p = s;
+	p += sprintf(p, "{\"n\": [1, -2, 3.5, 12345678901234, 7 ], \"pad\": [");
+	for (i = 0; p < s + CHECK_BULK_DOC; i++)
+		p += sprintf(p, "%s%d", i ? "," : "", i);
+	sprintf(p, "]}");
+
+	return s;
+}
+
+static void check_doc(const char *s, unsigned int flags)
+{
+	int64_t i64[8];
+	uint64_t u64[8];
+	double dbl[8];
+	json_data *d, *a;
+	size_t n;
+
+	d = json_data_from_string_ex(s, flags);
+	CHECK(d);
+	if (!d)
+		return;
+
+	a = json_data_get_by_name(d, "n");
+	CHECK(!json_data_to_double_array(a, dbl, 8, &n) && (n == 5) &&
+		(dbl[2] == 3.5) && (dbl[3] == 12345678901234.0));
+	CHECK(json_data_to_int64_array(a, i64, 8, &n) &&
+		(json_last_error()->code == JSON_ERR_RANGE) && (n == 2) &&
+		(i64[1] == -2));
+	CHECK(json_data_to_int64_array(a, i64, 1, &n) &&
+		(json_last_error()->code == JSON_ERR_LIMIT) && (n == 1));
+	CHECK(json_data_to_uint64_array(a, u64, 8, &n) && (n == 1));
+
+	/* the text of "a" and its elements is the copy of set_raw() */
+	CHECK(!json_data_set_raw(d, "a", "[[1]]", 5));
+	a = json_data_get_by_index(json_data_get_by_name(d, "a"), 0);
+	CHECK(!json_data_to_int64_array(a, i64, 8, &n) && (n == 1) &&
+		(i64[0] == 1));
+	CHECK(!json_data_set_raw(d, "b", "[12345678,1]", 12));
+	a = json_data_get_by_name(d, "b");
+	CHECK(!json_data_to_uint64_array(a, u64, 8, &n) && (n == 2) &&
+		(u64[0] == 12345678) && (u64[1] == 1));
+
+	/* a modified array is read from its nodes */
+	CHECK(!json_data_insert_raw(a, -1, "9", 1));
+	CHECK(!json_data_to_int64_array(a, i64, 8, &n) && (n == 3) &&
+		(i64[2] == 9));
+
+	json_data_free(d);
+}
+
+int main(void)
+{
+	size_t m;
+	char *s;
+
+	s = bulk_doc();
+	if (!s)
+		return -1;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+		check_doc(s, modes[m]);
+	free(s);
+
+	return check_end("check_bulk");
+}
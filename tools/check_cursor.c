@@ -0,0 +1,149 @@
+/*
+ * The cursor entering, searching and leaving containers: members found in
+ * document order, a missing one closing its object, values skipped or left
+ * half read, the depth limit, and errors that stay once set.
+ */
+#include "../json_cursor.h"
+#include "check.h"
+
+static const char *doc =
+	"{\"id\": 7, \"skip\": {\"deep\": [1, [2, {\"x\": \"}\"}]]},"
+	" \"list\": [{\"v\": 1}, {\"v\": -2, \"w\": 0}, {\"w\": 3}],"
+	" \"name\": \"a\\\"b\", \"last\": 1.5}";
+
+static void cursor_init(struct json_cursor *c, const char *s)
+{
+	json_cursor_init(c, s, strlen(s));
+}
+
+static void check_find(void)
+{
+	struct json_cursor c;
+	uint64_t id;
+	int64_t v;
+	double d;
+	char s[8];
+	int n = 0;
+
+	cursor_init(&c, doc);
+	CHECK(!json_cursor_enter_object(&c));
+	CHECK((json_cursor_find_field(&c, "id") == 1) &&
+		!json_cursor_get_uint64(&c, &id) && (id == 7));
+
+	/* "skip" is stepped over, brackets in its strings do not count */
+	CHECK(json_cursor_find_field(&c, "list") == 1);
+	CHECK(json_cursor_type(&c) == ARRAY);
+	CHECK(!json_cursor_enter_array(&c));
+	while (json_cursor_next_element(&c) == 1) {
+		CHECK(!json_cursor_enter_object(&c));
+		if (json_cursor_find_field(&c, "v") == 1) {
+			CHECK(!json_cursor_get_int64(&c, &v));
+			n += (int)v;
+			CHECK(json_cursor_leave(&c) == 0);
+		}
+	}
+	CHECK(n == -1);
+
+	CHECK((json_cursor_find_field(&c, "name") == 1) &&
+		!json_cursor_get_string(&c, s, sizeof(s)) && !strcmp(s, "a\"b"));
+	CHECK((json_cursor_find_field(&c, "last") == 1) &&
+		!json_cursor_get_double(&c, &d) && (d == 1.5));
+	CHECK(json_cursor_next_field(&c, NULL) == 0);
+	CHECK(json_cursor_type(&c) == -1);
+
+	/* a missing member ends the object, an earlier one is not found */
+	cursor_init(&c, doc);
+	CHECK(!json_cursor_enter_object(&c));
+	CHECK(json_cursor_find_field(&c, "list") == 1);
+	CHECK(json_cursor_find_field(&c, "id") == 0);
+	json_clear_error();
+	CHECK((json_cursor_next_field(&c, NULL) == -1) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+}
+
+static void check_leave(void)
+{
+	struct json_cursor c;
+	buf_t name;
+	int64_t v;
+
+	/* leave from the middle of nested containers */
+	cursor_init(&c, "[[1, [2, 3], 4], {\"a\": [5]}, 6]");
+	CHECK(!json_cursor_enter_array(&c) &&
+		(json_cursor_next_element(&c) == 1));
+	CHECK(!json_cursor_enter_array(&c) &&
+		(json_cursor_next_element(&c) == 1));
+	CHECK(!json_cursor_skip(&c));
+	CHECK(json_cursor_next_element(&c) == 1);
+	CHECK(!json_cursor_enter_array(&c) &&
+		(json_cursor_next_element(&c) == 1));
+	CHECK(json_cursor_leave(&c) == 0);
+	CHECK(json_cursor_leave(&c) == 0);
+	CHECK(json_cursor_next_element(&c) == 1);
+	CHECK(!json_cursor_enter_object(&c));
+	CHECK((json_cursor_next_field(&c, &name) == 1) && (name.len == 3) &&
+		!memcmp(name.p, "\"a\"", 3));
+	CHECK(json_cursor_leave(&c) == 0);
+	CHECK((json_cursor_next_element(&c) == 1) &&
+		!json_cursor_get_int64(&c, &v) && (v == 6));
+	CHECK(json_cursor_next_element(&c) == 0);
+
+	/* nothing is left to leave */
+	CHECK(json_cursor_leave(&c) == -1);
+
+	/* empty containers */
+	cursor_init(&c, "{\"a\": [], \"b\": {}}");
+	CHECK(!json_cursor_enter_object(&c));
+	CHECK((json_cursor_find_field(&c, "a") == 1) &&
+		!json_cursor_enter_array(&c) &&
+		(json_cursor_next_element(&c) == 0));
+	CHECK((json_cursor_find_field(&c, "b") == 1) &&
+		!json_cursor_enter_object(&c) &&
+		(json_cursor_next_field(&c, NULL) == 0));
+	CHECK(json_cursor_next_field(&c, NULL) == 0);
+}
+
+static void check_errors(void)
+{
+	struct json_cursor c;
+	char s[JSON_CURSOR_MAX_DEPTH * 2 + 8];
+	int64_t v;
+	int i;
+
+	/* the wrong container, then every call fails */
+	cursor_init(&c, "[1, 2]");
+	CHECK(json_cursor_enter_object(&c) == -1);
+	CHECK(json_cursor_enter_array(&c) == -1);
+	CHECK(json_cursor_get_int64(&c, &v) == -1);
+
+	cursor_init(&c, "{\"a\" 1}");
+	CHECK(!json_cursor_enter_object(&c));
+	CHECK(json_cursor_find_field(&c, "a") == -1);
+	CHECK(json_cursor_next_field(&c, NULL) == -1);
+
+	cursor_init(&c, "[1, 2");
+	CHECK(!json_cursor_enter_array(&c) &&
+		(json_cursor_next_element(&c) == 1));
+	CHECK(json_cursor_leave(&c) == -1);
+
+	/* one level past the limit */
+	for (i = 0; i <= JSON_CURSOR_MAX_DEPTH; i++)
+		s[i] = '[';
+	s[i] = '\0';
+	cursor_init(&c, s);
+	for (i = 0; i < JSON_CURSOR_MAX_DEPTH; i++)
+		CHECK(!json_cursor_enter_array(&c) &&
+			(json_cursor_next_element(&c) == 1));
+	json_clear_error();
+	CHECK((json_cursor_enter_array(&c) == -1) &&
+		(json_last_error()->code == JSON_ERR_LIMIT));
+}
+
+int main(void)
+{
+	check_find();
+	check_leave();
+	check_errors();
+
+	return check_end("check_cursor");
+}
@@ -0,0 +1,110 @@
+/*
+ * Every failing call leaves a cause in json_last_error(): parse errors with
+ * their position, conversions of numbers that do not parse or do not fit.
+ */
+#include "../json.h"
+#include "../json_bind.h"
+#include "check.h"
+
+static const unsigned int modes[] = {
+	0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+};
+
+static void check_parse(const char *s, enum json_error_code code,
+	size_t offset)
+{
+	const struct json_error *e;
+	json_data *d;
+	size_t m;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		json_clear_error();
+		d = json_data_from_string_ex(s, modes[m]);
+		e = json_last_error();
+		CHECK(!d && (e->code == code) && e->has_pos &&
+			(e->offset == offset));
+		json_data_free(d);
+	}
+}
+
+/* 'code' of the conversions of the text 's' to int64, uint64 and long */
+static void check_int(const char *s, enum json_error_code code)
+{
+	json_data *d;
+	int64_t i;
+	uint64_t u;
+	long l;
+
+	d = json_data_from_string(s);
+	CHECK(d);
+
+	json_clear_error();
+	CHECK(json_data_to_int64(d, &i) && (json_last_error()->code == code));
+	json_clear_error();
+	CHECK(json_data_to_long(d, &l) && (json_last_error()->code == code));
+	if (*s != '-') {
+		json_clear_error();
+		CHECK(json_data_to_uint64(d, &u) &&
+			(json_last_error()->code == code));
+	}
+	json_data_free(d);
+}
+
+struct bind_pt {
+	int8_t x;
+	float y;
+};
+
+static void check_bind(void)
+{
+	static const struct json_bind_field fields[] = {
+		JSON_BIND_SCALAR(struct bind_pt, x, JSON_BIND_INT),
+		JSON_BIND_SCALAR(struct bind_pt, y, JSON_BIND_DOUBLE),
+		JSON_BIND_END,
+	};
+	struct bind_pt pt;
+
+	json_clear_error();
+	CHECK(json_bind_from_string("{\"x\": 1000, \"y\": 1}", fields, &pt) &&
+		(json_last_error()->code == JSON_ERR_RANGE));
+	json_clear_error();
+	CHECK(json_bind_from_string("{\"x\": abc, \"y\": 1}", fields, &pt) &&
+		(json_last_error()->code == JSON_ERR_SYNTAX));
+	json_clear_error();
+	CHECK(json_bind_from_string("{\"x\": 1, \"y\": 1e}", fields, &pt) &&
+		(json_last_error()->code == JSON_ERR_SYNTAX));
+	CHECK(!json_bind_from_string("{\"x\": -7, \"y\": 0.5}", fields, &pt) &&
+		(pt.x == -7) && (pt.y == 0.5f));
+}
+
+int main(void)
+{
+	json_data *d;
+	double v;
+
+	json_clear_error();
+	CHECK(!json_data_from_string("") &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	check_parse("   ", JSON_ERR_SYNTAX, 3);
+	check_parse(" \n\t", JSON_ERR_SYNTAX, 3);
+	check_parse("[1,", JSON_ERR_SYNTAX, 3);
+	check_parse("{\"a\":1", JSON_ERR_SYNTAX, 6);
+	check_parse("\"abc", JSON_ERR_SYNTAX, 4);
+
+	check_int("abc", JSON_ERR_SYNTAX);
+	check_int("1.5", JSON_ERR_SYNTAX);
+	check_int("1x", JSON_ERR_SYNTAX);
+	check_int("tru", JSON_ERR_SYNTAX);
+	check_int("99999999999999999999", JSON_ERR_RANGE);
+	check_int("-9223372036854775809", JSON_ERR_RANGE);
+
+	d = json_data_from_string("1e");
+	json_clear_error();
+	CHECK(json_data_to_double(d, &v) &&
+		(json_last_error()->code == JSON_ERR_SYNTAX));
+	json_data_free(d);
+
+	check_bind();
+
+	return check_end("check_error");
+}
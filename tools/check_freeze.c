@@ -0,0 +1,156 @@
+/*
+ * Readers on threads sharing a frozen document, in every parse mode. The
+ * lookups of a frozen document must only read it, which is what this is
+ * built for: "make check" compiles it with ThreadSanitizer, a race shows
+ * as a report and a non-zero exit.
+ *
+ *	make check
+ *	./check_freeze [-t THREADS] [-r ROUNDS]
+ */
+#include <getopt.h>
+#include <pthread.h>
+
+#include "../json.h"
+
+#define CHECK_MEMBERS	300	/* above the default 'hash_min' */
+
+struct check_arg {
+	json_data *root;
+	int rounds;
+	int bad;
+};
+
+/* every member "i" is {"v": [0, i], "s": "a\"i", "e": {}} */
+static char *check_doc(void)
+{
+	char *s, *p;
+	int i;
+
+	s = (char *)malloc(CHECK_MEMBERS * 64 + 16);
+	if (!s)
+		return NULL;
+
+	p = s;
+	p += sprintf(p, "{");
+	for (i = 0; i < CHECK_MEMBERS; i++)
+		p += sprintf(p, "%s\"%d\": {\"v\": [0, %d], \"s\": \"a\\\"%d\", "
+			"\"e\": {}}", i ? ", " : "", i, i, i);
+	sprintf(p, "}");
+
+	return s;
+}
+
+static void *check_read(void *data)
+{
+	struct check_arg *a = (struct check_arg *)data;
+	json_data *o, *v;
+	unsigned long val;
+	buf_t view;
+	char name[16];
+	char str[16];
+	char want[16];
+	int r, i;
+
+	for (r = 0; r < a->rounds; r++) {
+		for (i = 0; i < CHECK_MEMBERS; i++) {
+			snprintf(name, sizeof(name), "%d", i);
+			o = json_data_get_by_name(a->root, name);
+			v = json_data_get_by_index(json_data_get_by_name(o, "v"), 1);
+			if (json_data_to_ulong(v, &val) || (val != (unsigned long)i))
+				a->bad++;
+			if (json_data_get_count(json_data_get_by_name(o, "e")) != 0)
+				a->bad++;
+			snprintf(want, sizeof(want), "a\"%d", i);
+			v = json_data_get_by_name(o, "s");
+			if (json_data_to_string(v, str, sizeof(str)) ||
+				strcmp(str, want))
+				a->bad++;
+			/* the escape was decoded by json_data_freeze() */
+			if (json_data_get_string(v, &view) ||
+				(view.len != strlen(want)) ||
+				memcmp(view.p, want, view.len))
+				a->bad++;
+		}
+		if (json_data_get_count(a->root) != CHECK_MEMBERS)
+			a->bad++;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		unsigned int flags;
+	} modes[] = {
+		{ "lazy", 0 },
+		{ "index", JSON_PARSE_INDEX },
+		{ "arena", JSON_PARSE_ARENA },
+		{ "parallel+arena", JSON_PARSE_PARALLEL | JSON_PARSE_ARENA },
+		{ "compact", JSON_PARSE_COMPACT },
+	};
+	struct check_arg a[64];
+	pthread_t tid[64];
+	int nthreads = 8;
+	int rounds = 20;
+	json_data *root;
+	size_t m;
+	int i, bad = 0;
+	char *s;
+	int ret;
+
+	while ((ret = getopt(argc, argv, "t:r:h")) != -1) {
+		switch (ret) {
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			printf("usage: %s [-t THREADS] [-r ROUNDS]\n", argv[0]);
+			return ret == 'h' ? 0 : -1;
+		}
+	}
+	if ((nthreads < 1) || (nthreads > 64))
+		nthreads = 8;
+
+	s = check_doc();
+	if (!s)
+		return -1;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		root = json_data_from_string_ex(s, modes[m].flags);
+		if (!root || json_data_freeze(root)) {
+			printf("%s: %s\n", modes[m].name, json_last_error()->msg);
+			bad++;
+			json_data_free(root);
+			continue;
+		}
+
+		for (i = 0; i < nthreads; i++) {
+			a[i].root = root;
+			a[i].rounds = rounds;
+			a[i].bad = 0;
+			if (pthread_create(&tid[i], NULL, check_read, &a[i])) {
+				printf("pthread_create error\n");
+				return -1;
+			}
+		}
+		for (i = 0; i < nthreads; i++) {
+			pthread_join(tid[i], NULL);
+			if (a[i].bad)
+				printf("%s: thread %d, %d bad\n", modes[m].name, i,
+					a[i].bad);
+			bad += a[i].bad;
+		}
+		json_data_free(root);
+	}
+	free(s);
+
+	printf("check_freeze: %d threads, %zu modes, %d bad\n", nthreads,
+		sizeof(modes) / sizeof(modes[0]), bad);
+
+	return bad ? -1 : 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Mutations written back with JSON_WRITE_VERBATIM: the subtrees that were
+ * not touched keep their text byte for byte, the modified ones are
+ * written from their nodes, and the output parses to the same tree as the
+ * plain rewrite.
+ */
+#include "../json_write.h"
+#include "check.h"
+
+static const unsigned int modes[] = {
+	0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+};
+
+static const char *doc =
+	"{ \"keep\" : [1,  2, {\"x\" :\"y\"}],\n \"arr\": [ 1 , 2 ,3 ],"
+	" \"obj\": {\"a\": 1, \"b\" : [ true ]}, \"gone\": null }";
+
+/* 'd' written with 'flags' is 's' */
+static int check_out(json_data *d, unsigned int flags, const char *s)
+{
+	struct json_writer *w;
+	const char *p;
+	size_t len;
+	int ret = 0;
+
+	w = json_writer_new_buf(flags);
+	if (w && !json_write_data(w, d)) {
+		p = json_writer_buf(w, &len);
+		ret = (len == strlen(s)) && !memcmp(p, s, len);
+	}
+	json_writer_free(w);
+
+	return ret;
+}
+
+static void check_doc(unsigned int flags)
+{
+	json_data *d, *arr, *obj, *r;
+	struct json_writer *w;
+	const char *p;
+	size_t len;
+
+	d = json_data_from_string_ex(doc, flags);
+	CHECK(d);
+	if (!d)
+		return;
+
+	arr = json_data_get_by_name(d, "arr");
+	obj = json_data_get_by_name(d, "obj");
+	CHECK(!json_data_insert_raw(arr, 1, " \"i\" ", 5));
+	CHECK(!json_data_replace_raw(arr, 0, "[ 0 ]", 5));
+	CHECK(!json_data_remove_by_index(arr, 3));
+	CHECK(!json_data_set_raw(obj, "a", "{ \"n\" : 1 }", 11));
+	CHECK(!json_data_set_raw(obj, "c", "-3", 2));
+	CHECK(!json_data_remove_by_name(d, "gone"));
+	CHECK(json_data_get_count(arr) == 3);
+
+	/* "keep" and "b" are copied, the rest is written from the nodes */
+	CHECK(check_out(d, JSON_WRITE_VERBATIM,
+		"{\"keep\":[1,  2, {\"x\" :\"y\"}],\"arr\":[[0],\"i\",2],"
+		"\"obj\":{\"a\":{\"n\":1},\"b\":[ true ],\"c\":-3}}"));
+	CHECK(check_out(d, 0,
+		"{\"keep\":[1,2,{\"x\":\"y\"}],\"arr\":[[0],\"i\",2],"
+		"\"obj\":{\"a\":{\"n\":1},\"b\":[true],\"c\":-3}}"));
+	CHECK(check_out(json_data_get_by_name(d, "keep"), JSON_WRITE_VERBATIM,
+		"[1,  2, {\"x\" :\"y\"}]"));
+
+	/* failed mutations leave the document as it was */
+	json_clear_error();
+	CHECK(json_data_insert_raw(arr, 9, "1", 1) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(json_data_set_raw(obj, "d\"", "1", 1) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(json_data_set_raw(obj, "d", "[1,", 3) &&
+		(json_last_error()->code == JSON_ERR_SYNTAX));
+	CHECK(json_data_remove_by_name(obj, "none"));
+	CHECK(json_data_set_raw(arr, "d", "1", 1) &&
+		(json_last_error()->code == JSON_ERR_TYPE));
+	CHECK(json_data_get_count(obj) == 3);
+
+	/* the verbatim output reads back as the same tree */
+	w = json_writer_new_buf(JSON_WRITE_VERBATIM);
+	CHECK(w && !json_write_data(w, d));
+	p = json_writer_buf(w, &len);
+	r = json_data_from_mem(p, len, flags);
+	json_writer_free(w);
+	CHECK(r && check_out(r, 0,
+		"{\"keep\":[1,2,{\"x\":\"y\"}],\"arr\":[[0],\"i\",2],"
+		"\"obj\":{\"a\":{\"n\":1},\"b\":[true],\"c\":-3}}"));
+	json_data_free(r);
+
+	json_data_free(d);
+}
+
+int main(void)
+{
+	size_t m;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+		check_doc(modes[m]);
+
+	return check_end("check_mutate");
+}
@@ -0,0 +1,139 @@
+/*
+ * json_data_to_double() against strtod() of the C library on generated
+ * numbers: short and long mantissas, exponents near the limits of double,
+ * and digit runs past the 19 the fast path takes. The numeric locale is
+ * taken from the environment, the parse must not depend on it.
+ *
+ *	make check
+ *	LC_NUMERIC=de_DE.UTF-8 ./check_number [-n COUNT] [-s SEED]
+ */
+#include <getopt.h>
+#include <locale.h>
+
+#include "../json.h"
+
+#define CHECK_NUMBER_MAX	512
+
+static uint64_t seed = 1;
+
+/* xorshift64*, the inputs are the same from one run to the next */
+static uint64_t rnd(void)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return seed * 2685821657736338717ULL;
+}
+
+static size_t gen_digits(char *s, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		s[i] = '0' + rnd() % 10;
+	/* no leading zero, JSON does not allow it */
+	if (n > 1 && s[0] == '0')
+		s[0] = '1';
+
+	return n;
+}
+
+/* one JSON number in 's', NUL terminated */
+static void gen_number(char *s)
+{
+	size_t n = 0;
+	int e;
+
+	if (rnd() & 1)
+		s[n++] = '-';
+
+	switch (rnd() % 5) {
+	case 0:
+		/* as printed by the C library, mostly round trips */
+		n += snprintf(s + n, 64, "%.*g", 1 + (int)(rnd() % 17),
+			(double)(rnd() >> 11) / (double)(1 + rnd() % 1000000));
+		break;
+	case 1:
+		/* short mantissa, any exponent of double and past it */
+		n += gen_digits(s + n, 1 + rnd() % 19);
+		e = (int)(rnd() % 700) - 350;
+		n += sprintf(s + n, "e%d", e);
+		break;
+	case 2:
+		/* more digits than a uint64_t holds */
+		n += gen_digits(s + n, 20 + rnd() % 40);
+		s[n++] = '.';
+		n += gen_digits(s + n, 1 + rnd() % 40);
+		e = (int)(rnd() % 80) - 40;
+		n += sprintf(s + n, "E%+d", e);
+		break;
+	case 3:
+		/* longer than any stack buffer of the parse */
+		s[n++] = '0';
+		s[n++] = '.';
+		n += gen_digits(s + n, 100 + rnd() % 300);
+		break;
+	default:
+		/* subnormals and the edges of the range */
+		n += gen_digits(s + n, 1 + rnd() % 17);
+		e = (rnd() & 1) ? -300 - (int)(rnd() % 30) :
+			290 + (int)(rnd() % 20);
+		n += sprintf(s + n, "e%d", e);
+		break;
+	}
+	s[n] = '\0';
+}
+
+int main(int argc, char *argv[])
+{
+	char s[CHECK_NUMBER_MAX];
+	unsigned long count = 200000;
+	unsigned long i, bad = 0;
+	json_data *d;
+	double v, ref;
+	int ret;
+
+	while ((ret = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (ret) {
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			if (!seed)
+				seed = 1;
+			break;
+		default:
+			printf("usage: %s [-n COUNT] [-s SEED]\n", argv[0]);
+			return ret == 'h' ? 0 : -1;
+		}
+	}
+
+	setlocale(LC_NUMERIC, "");
+
+	for (i = 0; i < count; i++) {
+		gen_number(s);
+		d = json_data_from_string(s);
+		if (!d) {
+			printf("%s: %s\n", s, json_last_error()->msg);
+			bad++;
+			continue;
+		}
+		/* the reference is parsed in the C locale as well */
+		setlocale(LC_NUMERIC, "C");
+		ref = strtod(s, NULL);
+		setlocale(LC_NUMERIC, "");
+		ret = json_data_to_double(d, &v);
+		/* out of range is HUGE_VAL or 0 for both */
+		if (ret || (v != ref)) {
+			if (bad < 10)
+				printf("%s: %.17g, strtod %.17g\n", s, v, ref);
+			bad++;
+		}
+		json_data_free(d);
+	}
+
+	printf("check_number: %lu numbers, %lu bad\n", count, bad);
+
+	return bad ? -1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * JSON_PARSE_PARALLEL builds the tape from the offsets of the structural
+ * characters, JSON_PARSE_INDEX from the text. Both take the same grammar:
+ * each input below is parsed into the same tree, or fails in both.
+ */
+#include "../json_write.h"
+#include "check.h"
+
+/* above the chunk of json_index_build(), so that it runs on threads */
+#define CHECK_PARALLEL_PAD	(3 << 20)
+
+static const char *inputs[] = {
+	"{\"a\": 1, \"b\": [true, null], \"c\": {\"d\": \"e\\\"}\"}}",
+	"{\"a\": 1,}",
+	"{, \"a\": 1}",
+	"{\"a\": 1,, \"b\": 2}",
+	"{\"a\": , \"b\": 1}",
+	"{\"a\": 1 \"b\": 2}",
+	"{\"a\" 1}",
+	"{ , }",
+	"[1,]",
+	"[, 1]",
+	"[1,, 2]",
+	"[1 2]",
+	"[ , ]",
+	"[]",
+	"{}",
+	NULL,
+};
+
+/* the inputs that fail, with the code of the failure */
+static const struct {
+	const char *s;
+	enum json_error_code code;
+} fails[] = {
+	{ "{\"\": 1}", JSON_ERR_SYNTAX },
+	{ "{: 1}", JSON_ERR_SYNTAX },
+	{ NULL, 0 },
+};
+
+/* 'x' padded to a document that the parallel parse takes */
+static char *parallel_doc(const char *x)
+{
+	char *s;
+	int n;
+
+	s = (char *)malloc(CHECK_PARALLEL_PAD + strlen(x) + 32);
+	if (!s)
+		return NULL;
+
+	n = sprintf(s, "{\"x\": %s, \"pad\": \"", x);
+	memset(s + n, 'p', CHECK_PARALLEL_PAD);
+	strcpy(s + n + CHECK_PARALLEL_PAD, "\"}");
+
+	return s;
+}
+
+/* member "x" of 'd' written by json_write_data() */
+static struct json_writer *parallel_write(json_data *d)
+{
+	struct json_writer *w;
+
+	w = json_writer_new_buf(0);
+	if (w && json_write_data(w, json_data_get_by_name(d, "x"))) {
+		json_writer_free(w);
+		w = NULL;
+	}
+
+	return w;
+}
+
+static void check_same(const char *x)
+{
+	struct json_writer *w[2];
+	const char *p[2];
+	size_t len[2];
+	json_data *d[2];
+	char *s;
+
+	s = parallel_doc(x);
+	CHECK(s);
+	if (!s)
+		return;
+
+	d[0] = json_data_from_string_ex(s, JSON_PARSE_INDEX);
+	d[1] = json_data_from_string_ex(s, JSON_PARSE_PARALLEL);
+	CHECK(d[0] && d[1]);
+	if (d[0] && d[1]) {
+		w[0] = parallel_write(d[0]);
+		w[1] = parallel_write(d[1]);
+		CHECK(w[0] && w[1]);
+		if (w[0] && w[1]) {
+			p[0] = json_writer_buf(w[0], &len[0]);
+			p[1] = json_writer_buf(w[1], &len[1]);
+			CHECK((len[0] == len[1]) && !memcmp(p[0], p[1], len[0]));
+		}
+		json_writer_free(w[0]);
+		json_writer_free(w[1]);
+	}
+	json_data_free(d[0]);
+	json_data_free(d[1]);
+	free(s);
+}
+
+static void check_fail(const char *x, enum json_error_code code)
+{
+	static const unsigned int modes[] = {
+		JSON_PARSE_INDEX, JSON_PARSE_PARALLEL,
+	};
+	json_data *d;
+	size_t m;
+	char *s;
+
+	s = parallel_doc(x);
+	CHECK(s);
+	if (!s)
+		return;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		json_clear_error();
+		d = json_data_from_string_ex(s, modes[m]);
+		CHECK(!d && (json_last_error()->code == code));
+		json_data_free(d);
+	}
+	free(s);
+}
+
+int main(void)
+{
+	int i;
+
+	json_data_set_parse_threads(4);
+
+	for (i = 0; inputs[i]; i++)
+		check_same(inputs[i]);
+	for (i = 0; fails[i].s; i++)
+		check_fail(fails[i].s, fails[i].code);
+
+	return check_end("check_parallel");
+}
@@ -0,0 +1,201 @@
+/*
+ * Compiled paths: both syntaxes, pointer escapes, expressions that do not
+ * compile, and the node cached in the handle, which must follow the
+ * document it is resolved against and its mutations. Projections by
+ * json_path_parse() must resolve the same paths to the same text as the
+ * full parse, and hold nothing else.
+ */
+#include "../json_path.h"
+#include "check.h"
+
+static const unsigned int modes[] = {
+	0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+};
+
+static const char *doc =
+	"{\"flow\": [{\"ttl\": 1}, {\"ttl\": 2, \"tos\": [7, 8]}],"
+	" \"a/b\": {\"c~d\": 3}, \"0\": {\"10\": 4}}";
+
+/* 'expr' resolves in 'd' to the number 'val', -1 for no node */
+static int path_is(json_data *d, const char *expr, long val)
+{
+	struct json_path *path;
+	json_data *v;
+	long n = -1;
+
+	path = json_path_compile(expr);
+	if (!path)
+		return 0;
+	v = json_path_get(path, d);
+	if (v && json_data_to_long(v, &n))
+		n = -2;
+	json_path_free(path);
+
+	return n == val;
+}
+
+static void check_get(unsigned int flags)
+{
+	struct json_path *path;
+	json_data *d;
+
+	d = json_data_from_string_ex(doc, flags);
+	CHECK(d);
+	if (!d)
+		return;
+
+	CHECK(path_is(d, "flow[1].ttl", 2));
+	CHECK(path_is(d, "flow[1].tos[1]", 8));
+	CHECK(path_is(d, "/flow/0/ttl", 1));
+	CHECK(path_is(d, "/flow/1/tos/0", 7));
+	CHECK(path_is(d, "/a~1b/c~0d", 3));
+	CHECK(path_is(d, "/0/10", 4));
+	path = json_path_compile("");
+	CHECK(path && (json_path_get(path, d) == d));
+	json_path_free(path);
+
+	/* steps that do not lead anywhere */
+	CHECK(path_is(d, "flow[2].ttl", -1));
+	CHECK(path_is(d, "flow.ttl", -1));
+	CHECK(path_is(d, "/flow/ttl", -1));
+	CHECK(path_is(d, "/flow/01", -1));
+	CHECK(path_is(d, "flow[0].ttl.x", -1));
+
+	json_data_free(d);
+}
+
+static void check_compile(const char *expr, enum json_error_code code)
+{
+	json_clear_error();
+	CHECK(!json_path_compile(expr) && (json_last_error()->code == code));
+}
+
+static void check_cache(void)
+{
+	struct json_path *path;
+	json_data *a, *b, *v;
+	long n;
+
+	a = json_data_from_string_ex(doc, JSON_PARSE_INDEX);
+	b = json_data_from_string("{\"flow\": [0, {\"ttl\": 9}]}");
+	path = json_path_compile("flow[1].ttl");
+	CHECK(a && b && path);
+	if (!a || !b || !path)
+		goto out;
+
+	/* the handle switches between documents */
+	v = json_path_get(path, a);
+	CHECK(v && (json_path_get(path, a) == v));
+	CHECK(!json_data_to_long(json_path_get(path, b), &n) && (n == 9));
+	CHECK(json_path_get(path, a) == v);
+
+	/* a mutation of the document drops the cached node */
+	CHECK(!json_data_set_raw(json_data_get_by_index(
+		json_data_get_by_name(a, "flow"), 1), "ttl", "12", 2));
+	CHECK(!json_data_to_long(json_path_get(path, a), &n) && (n == 12));
+	CHECK(!json_data_remove_by_index(json_data_get_by_name(a, "flow"), 1));
+	CHECK(!json_path_get(path, a));
+
+out:
+	json_path_free(path);
+	json_data_free(a);
+	json_data_free(b);
+}
+
+/* the paths of 'exprs' resolve in the projection as in the full parse */
+static void check_proj_same(const char *s, const char *const *exprs,
+	size_t n, unsigned int flags)
+{
+	struct json_path *path;
+	json_data *full, *proj, *a, *b;
+	size_t i;
+
+	full = json_data_from_string_ex(s, flags);
+	proj = json_path_parse(s, strlen(s), exprs, n, flags);
+	CHECK(full && proj);
+	if (!full || !proj)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		path = json_path_compile(exprs[i]);
+		CHECK(path);
+		if (!path)
+			continue;
+		a = json_path_get(path, full);
+		b = json_path_get(path, proj);
+		CHECK(a && b && (a->type == b->type) &&
+			(a->value.len == b->value.len) &&
+			!memcmp(a->value.p, b->value.p, a->value.len));
+		json_path_free(path);
+	}
+
+out:
+	json_data_free(full);
+	json_data_free(proj);
+}
+
+static void check_proj(unsigned int flags)
+{
+	static const char *const exprs[] = {
+		"flow[1].tos[1]", "/a~1b", "0",
+	};
+	static const char *const odd[] = {
+		"x[1]", "x[2].b", "y.b",
+	};
+	static const char *const bad[] = { "x[1].b" };
+	const char *s;
+	json_data *d;
+
+	check_proj_same(doc, exprs, 3, flags);
+	/* stray commas and empty values, as the other parses take them */
+	check_proj_same("{\"x\": [, 1, , 2, {\"b\": 3,},], \"y\": {, \"a\": ,"
+		" \"b\": 4,,}}", odd, 3, flags);
+
+	/* only what is reached has a node, elements keep their index */
+	d = json_path_parse(doc, strlen(doc), exprs, 1, flags);
+	CHECK(d && (json_data_get_count(d) == 1));
+	CHECK(!json_data_get_by_name(d, "a/b"));
+	CHECK(json_data_get_count(json_data_get_by_name(d, "flow")) == 2);
+	CHECK(json_data_get_count(json_data_get_by_index(
+		json_data_get_by_name(d, "flow"), 1)) == 1);
+	json_data_free(d);
+
+	/* what is reached is checked, a subtree stepped over only matched */
+	s = "{\"x\": [1 2}";
+	json_clear_error();
+	CHECK(!json_path_parse(s, strlen(s), odd, 1, flags) &&
+		(json_last_error()->code == JSON_ERR_SYNTAX));
+	s = "{\"x\": [0, {: 1}]}";
+	json_clear_error();
+	CHECK(!json_path_parse(s, strlen(s), bad, 1, flags) &&
+		(json_last_error()->code == JSON_ERR_SYNTAX));
+	s = "{\"z\": [1 2 :], \"x\": [0, 5]}";
+	d = json_path_parse(s, strlen(s), odd, 1, flags);
+	CHECK(d && !json_data_get_by_name(d, "z"));
+	json_data_free(d);
+	json_clear_error();
+	CHECK(!json_path_parse(doc, strlen(doc), NULL, 1, flags) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+}
+
+int main(void)
+{
+	size_t m;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		check_get(modes[m]);
+		check_proj(modes[m]);
+	}
+
+	check_compile(NULL, JSON_ERR_ARG);
+	check_compile("flow[x]", JSON_ERR_SYNTAX);
+	check_compile("flow[1", JSON_ERR_SYNTAX);
+	check_compile("flow..ttl", JSON_ERR_SYNTAX);
+	check_compile("flow[01]", JSON_ERR_RANGE);
+	check_compile("/a~2b", JSON_ERR_ESCAPE);
+	check_compile("/a~", JSON_ERR_ESCAPE);
+
+	check_cache();
+
+	return check_end("check_path");
+}
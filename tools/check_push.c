@@ -0,0 +1,143 @@
+/*
+ * The push parser fed the same input whole and one byte at a time: the
+ * events, their tokens and the documents must not depend on where the
+ * chunks end, also inside escapes, numbers and literals.
+ */
+#include "../json_push.h"
+#include "../json_write.h"
+#include "check.h"
+
+#define CHECK_PUSH_TRACE	4096
+
+struct push_trace {
+	char s[CHECK_PUSH_TRACE];
+	size_t len;
+	int docs;
+};
+
+static void trace_add(struct push_trace *t, const char *p, size_t len)
+{
+	if (t->len + len >= sizeof(t->s))
+		len = sizeof(t->s) - t->len - 1;
+	memcpy(t->s + t->len, p, len);
+	t->len += len;
+	t->s[t->len] = '\0';
+}
+
+/* one letter per event, followed by its token */
+static int trace_event(void *arg, enum json_push_event ev, buf_t *tok)
+{
+	struct push_trace *t = (struct push_trace *)arg;
+	char c = "{}[]NSMD"[ev];
+
+	trace_add(t, &c, 1);
+	if (tok)
+		trace_add(t, tok->p, tok->len);
+
+	return 0;
+}
+
+/* every document, written back */
+static int trace_doc(void *arg, json_data *d)
+{
+	struct push_trace *t = (struct push_trace *)arg;
+	struct json_writer *w;
+	const char *p;
+	size_t len;
+
+	w = json_writer_new_buf(0);
+	if (w && !json_write_data(w, d)) {
+		p = json_writer_buf(w, &len);
+		trace_add(t, "=", 1);
+		trace_add(t, p, len);
+	}
+	json_writer_free(w);
+	json_data_free(d);
+	t->docs++;
+
+	return 0;
+}
+
+/* 's' fed in chunks of 'step' bytes, returns the result of the parse */
+static int push_run(const char *s, size_t step, unsigned int flags,
+	struct push_trace *t)
+{
+	struct json_push *p;
+	size_t len = strlen(s);
+	size_t i, n;
+	int ret = 0;
+
+	t->len = 0;
+	t->s[0] = '\0';
+	t->docs = 0;
+
+	p = json_push_new(trace_event, trace_doc, t, flags);
+	if (!p)
+		return -1;
+	for (i = 0; !ret && (i < len); i += n) {
+		n = (len - i < step) ? len - i : step;
+		ret = json_push_feed(p, s + i, n);
+	}
+	if (!ret)
+		ret = json_push_finish(p);
+	json_push_free(p);
+
+	return ret;
+}
+
+/* 's' is parsed the same in every chunking, into 'docs' documents */
+static void check_same(const char *s, int docs)
+{
+	static const unsigned int modes[] = {
+		0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+	};
+	static struct push_trace whole, t;
+	size_t step, m;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		CHECK(!push_run(s, strlen(s), modes[m], &whole) &&
+			(whole.docs == docs));
+		for (step = 1; step <= 3; step++) {
+			CHECK(!push_run(s, step, modes[m], &t) &&
+				(t.docs == docs) && !strcmp(t.s, whole.s));
+		}
+	}
+}
+
+/* 's' fails in every chunking */
+static void check_fail(const char *s)
+{
+	static struct push_trace t;
+	size_t step;
+
+	for (step = 1; step <= strlen(s); step++) {
+		json_clear_error();
+		CHECK(push_run(s, step, 0, &t) &&
+			(json_last_error()->code == JSON_ERR_SYNTAX));
+	}
+}
+
+int main(void)
+{
+	static struct push_trace t;
+
+	check_same("{\"a\": [1, -2.5e+3, true, null], \"b\\\"c\": \"d\\\\e\"}", 1);
+	check_same("[\"\\u00e9\\n\", \"\\\\\", \"\\\"\", \"\"]", 1);
+	check_same("{\"\\u0041\\/\": {\"x\": false}}", 1);
+	check_same("1 2\n[3] {\"a\":\"4\"} \"5\" 6", 6);
+	check_same("  12345678901234567890  ", 1);
+	check_same("[[[[]]], {}, [{}]]", 1);
+
+	/* the tokens are whole, also those split by the byte feed */
+	CHECK(!push_run("[\"a\\\"b\", 123, {\"k\\\\\": null}]", 1, 0, &t) &&
+		!strcmp(t.s, "[S\"a\\\"b\"M123{N\"k\\\\\"Mnull}]="
+			"[\"a\\\"b\",123,{\"k\\\\\":null}]D"));
+
+	check_fail("[1 2]");
+	check_fail("{\"a\" 1}");
+	check_fail("{1: 2}");
+	check_fail("[\"abc");
+	check_fail("{\"a\": [1, 2}");
+
+	return check_end("check_push");
+}
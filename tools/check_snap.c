@@ -0,0 +1,151 @@
+/*
+ * Snapshots saved from every parse mode, and from a modified document,
+ * opened again and walked against the tree they were saved from: types,
+ * counts, member lookups and the text of every value must agree.
+ */
+#include <unistd.h>
+
+#include "../json_snap.h"
+#include "check.h"
+
+#define CHECK_SNAP_MEMBERS	300	/* large enough for a name index */
+
+/* every member "i" is {"v": [i, -1.5, true, null], "s": "a\"b"} */
+static char *snap_doc(void)
+{
+	char *s, *p;
+	int i;
+
+	s = (char *)malloc(CHECK_SNAP_MEMBERS * 64 + 64);
+	if (!s)
+		return NULL;
+
+	p = s;
+	p += sprintf(p, "{\"empty\": {}, \"none\": [],");
+	for (i = 0; i < CHECK_SNAP_MEMBERS; i++)
+		p += sprintf(p, "%s\"%d\": {\"v\": [%d, -1.5, true, null], "
+			"\"s\": \"a\\\"b\"}", i ? ", " : " ", i, i);
+	sprintf(p, "}");
+
+	return s;
+}
+
+/* 'd' and the node 'n' of 's' hold the same value */
+static int snap_same(struct json_snap *s, json_snap_node n, json_data *d)
+{
+	char name[64];
+	json_data *e;
+	buf_t val;
+	int i = 0;
+
+	if ((n == JSON_SNAP_NONE) || (json_snap_type(s, n) != d->type))
+		return 0;
+
+	if ((d->type != OBJECT) && (d->type != ARRAY)) {
+		return !json_snap_value(s, n, &val) &&
+			(val.len == d->value.len) &&
+			!memcmp(val.p, d->value.p, val.len);
+	}
+
+	if (json_snap_count(s, n) != json_data_get_count(d))
+		return 0;
+
+	TAILQ_FOREACH(e, &d->head, next) {
+		if (d->type == ARRAY) {
+			if (!snap_same(s, json_snap_get_by_index(s, n, i++), e))
+				return 0;
+			continue;
+		}
+		if (e->name.len - 2 >= sizeof(name))
+			return 0;
+		memcpy(name, e->name.p + 1, e->name.len - 2);
+		name[e->name.len - 2] = '\0';
+		if (!snap_same(s, json_snap_get_by_name(s, n, name), e))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* 'd' saved to 'file' and opened again */
+static void check_round(json_data *d, const char *file)
+{
+	struct json_snap *s;
+
+	CHECK(!json_snap_save(d, file));
+	s = json_snap_open(file);
+	CHECK(s && snap_same(s, json_snap_root(s), d));
+	json_snap_close(s);
+}
+
+static void check_modified(const char *doc, const char *file)
+{
+	struct json_snap *old;
+	json_data *d;
+	int64_t v;
+
+	d = json_data_from_string_ex(doc, JSON_PARSE_COMPACT);
+	CHECK(d);
+	if (!d)
+		return;
+
+	CHECK(!json_snap_save(d, file));
+	old = json_snap_open(file);
+	CHECK(old);
+
+	CHECK(!json_data_set_raw(json_data_get_by_name(d, "7"), "v", "[70]", 4));
+	CHECK(!json_data_remove_by_name(d, "8"));
+	CHECK(!json_data_set_raw(d, "new", "{\"x\": 1}", 8));
+	check_round(d, file);
+
+	/* the snapshot that was open keeps its content */
+	CHECK(old && !json_snap_to_int64(old, json_snap_get_by_index(old,
+		json_snap_get_by_name(old, json_snap_get_by_name(old,
+		json_snap_root(old), "7"), "v"), 0), &v) && (v == 7));
+	CHECK(old && (json_snap_get_by_name(old, json_snap_root(old), "8") !=
+		JSON_SNAP_NONE));
+	json_snap_close(old);
+
+	json_data_free(d);
+}
+
+int main(void)
+{
+	static const unsigned int modes[] = {
+		0, JSON_PARSE_INDEX, JSON_PARSE_ARENA, JSON_PARSE_COMPACT,
+		JSON_PARSE_PARALLEL | JSON_PARSE_ARENA, JSON_PARSE_MMAP,
+	};
+	char file[64], src[64];
+	json_data *d;
+	size_t m;
+	FILE *fp;
+	char *s;
+
+	s = snap_doc();
+	if (!s)
+		return -1;
+	snprintf(file, sizeof(file), "/tmp/check_snap.%d", (int)getpid());
+	snprintf(src, sizeof(src), "/tmp/check_snap.%d.json", (int)getpid());
+
+	/* JSON_PARSE_MMAP needs the document in a file */
+	fp = fopen(src, "w");
+	CHECK(fp && (fputs(s, fp) >= 0) && !fclose(fp));
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		d = json_data_from_file_ex(src, modes[m]);
+		CHECK(d);
+		if (d)
+			check_round(d, file);
+		json_data_free(d);
+	}
+	check_modified(s, file);
+
+	CHECK(!json_snap_open(src) &&
+		(json_last_error()->code == JSON_ERR_IO));
+
+	unlink(file);
+	unlink(src);
+	free(s);
+
+	return check_end("check_snap");
+}
@@ -0,0 +1,130 @@
+/*
+ * The writer: commas and nesting of values written one by one, calls that
+ * do not fit the open container, doubles that read back the same, and a
+ * parsed tree written again.
+ */
+#include <math.h>
+
+#include "../json_write.h"
+#include "check.h"
+
+/* the output so far of 'w' is 's' */
+static int check_out(struct json_writer *w, const char *s)
+{
+	const char *p;
+	size_t len;
+
+	p = json_writer_buf(w, &len);
+	return p && (len == strlen(s)) && !memcmp(p, s, len);
+}
+
+static void check_nesting(void)
+{
+	struct json_writer *w;
+
+	w = json_writer_new_buf(0);
+	CHECK(w);
+	CHECK(!json_write_object_begin(w));
+	CHECK(!json_write_name(w, "a", 1));
+	CHECK(!json_write_array_begin(w));
+	CHECK(!json_write_int64(w, 1));
+	CHECK(!json_write_string(w, "x\"\n", 3));
+	CHECK(!json_write_null(w));
+	CHECK(!json_write_array_end(w));
+	CHECK(!json_write_name(w, "b", 1));
+	CHECK(!json_write_object_begin(w));
+	CHECK(!json_write_object_end(w));
+	CHECK(!json_write_object_end(w));
+	CHECK(check_out(w, "{\"a\":[1,\"x\\\"\\n\",null],\"b\":{}}"));
+	json_writer_free(w);
+}
+
+/* every misuse fails with JSON_ERR_ARG and leaves the output alone */
+static void check_misuse(void)
+{
+	struct json_writer *w;
+
+	w = json_writer_new_buf(0);
+	CHECK(w);
+	CHECK(!json_write_array_begin(w));
+	CHECK(json_write_name(w, "a", 1) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(!json_write_int64(w, 1));
+	CHECK(json_write_object_end(w) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(!json_write_object_begin(w));
+	CHECK(json_write_int64(w, 2) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(json_write_array_end(w) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(!json_write_name(w, "b", 1));
+	CHECK(json_write_name(w, "c", 1) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(json_write_object_end(w) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(!json_write_int64(w, 3));
+	CHECK(!json_write_object_end(w));
+	CHECK(!json_write_array_end(w));
+	CHECK(json_write_array_end(w) &&
+		(json_last_error()->code == JSON_ERR_ARG));
+	CHECK(check_out(w, "[1,{\"b\":3}]"));
+	json_writer_free(w);
+}
+
+static void check_double(void)
+{
+	static const double vals[] = {
+		0.1, 1.0 / 3, 1e21, 1e-7, 123456.789, 5e-324, 1.7976931348623157e308,
+		-2.5, 0.000001,
+	};
+	struct json_writer *w;
+	const char *p;
+	json_data *d;
+	size_t i, len;
+	double v;
+
+	for (i = 0; i < sizeof(vals) / sizeof(vals[0]); i++) {
+		w = json_writer_new_buf(0);
+		CHECK(!json_write_double(w, vals[i]));
+		p = json_writer_buf(w, &len);
+		d = json_data_from_mem(p, len, 0);
+		CHECK(d && !json_data_to_double(d, &v) && (v == vals[i]));
+		json_data_free(d);
+		json_writer_free(w);
+	}
+
+	w = json_writer_new_buf(0);
+	CHECK(!json_write_double(w, NAN));
+	CHECK(check_out(w, "null"));
+	json_writer_free(w);
+}
+
+static void check_tree(void)
+{
+	static const char s[] = "{\"a\": [1, 2, {\"b\": \"c\\u0041\"}], \"d\": {}}";
+	struct json_writer *w;
+	json_data *d;
+
+	d = json_data_from_string(s);
+	CHECK(d);
+	w = json_writer_new_buf(0);
+	CHECK(!json_write_data(w, d));
+	CHECK(check_out(w, "{\"a\":[1,2,{\"b\":\"c\\u0041\"}],\"d\":{}}"));
+	json_writer_free(w);
+
+	w = json_writer_new_buf(JSON_WRITE_VERBATIM);
+	CHECK(!json_write_data(w, d));
+	CHECK(check_out(w, s));
+	json_writer_free(w);
+	json_data_free(d);
+}
+
+int main(void)
+{
+	check_nesting();
+	check_misuse();
+	check_double();
+	check_tree();
+
+	return check_end("check_write");
+}